@@ -0,0 +1,293 @@
+#define _POSIX_C_SOURCE 200809L
+#include "frontend/tokenizer.h"
+#include "frontend/parser.h"
+#include "frontend/document.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+/*
+ * Frontend throughput: tokenizerAdvance in every input mode, then parserParse
+ * over the whole file. With --json every measurement is one JSON object per
+ * line so runs can be diffed or fed to a regression checker.
+*/
+
+
+typedef struct {
+    const char *bench;
+    const char *mode;
+    const char *file;
+    size_t bytes;
+    size_t tokens;
+    size_t nodes;
+    size_t tree_bytes;
+    size_t arena_used;
+    size_t arena_peak;
+    double seconds;
+    bool ok;
+} Result;
+
+
+static bool json = false;
+
+
+static double now(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+
+static char get_char(void *p_ctx) {
+    return (char)getc((FILE*)p_ctx);
+}
+
+
+static size_t lex_all(Tokenizer *p_tokenizer) {
+    size_t count = 0;
+    TokenType type;
+    do {
+        type = tokenizerTokenGetType(tokenizerAdvance(p_tokenizer));
+        count++;
+    } while (type != TK_EOF && type != TK_ERROR);
+    return count;
+}
+
+
+static size_t flat_count(const FlatTree *p_tree, FlatIndex p_index) {
+    const FlatNode *node = flatTreeGetNode(p_tree, p_index);
+    size_t count = 1;
+    for (uint32_t i = 0; i < node->child_count; i++)
+        count += flat_count(p_tree, node->first_child + i);
+    return count;
+}
+
+
+static void report(const Result *p_result) {
+    double mb_per_s = p_result->bytes / p_result->seconds / 1e6;
+    double tokens_per_s = p_result->tokens / p_result->seconds;
+    double nodes_per_s = p_result->nodes / p_result->seconds;
+    if (json) {
+        printf("{\"bench\": \"%s\", \"mode\": \"%s\", \"file\": \"%s\", \"ok\": %s, "
+            "\"bytes\": %zu, \"tokens\": %zu, \"nodes\": %zu, \"seconds\": %.6f, "
+            "\"mb_per_s\": %.3f, \"tokens_per_s\": %.0f, \"nodes_per_s\": %.0f, "
+            "\"tree_bytes\": %zu, \"arena_used\": %zu, \"arena_peak\": %zu}\n",
+            p_result->bench, p_result->mode, p_result->file, p_result->ok ? "true" : "false",
+            p_result->bytes, p_result->tokens, p_result->nodes, p_result->seconds,
+            mb_per_s, tokens_per_s, nodes_per_s, p_result->tree_bytes, p_result->arena_used, p_result->arena_peak);
+        return;
+    }
+    printf("%-6s %-9s %10zu tokens %10.3f ms %12.0f tokens/s %9.1f MB/s",
+        p_result->bench, p_result->mode, p_result->tokens, p_result->seconds * 1e3, tokens_per_s, mb_per_s);
+    if (strcmp(p_result->bench, "lex"))
+        printf(" %10zu nodes %12.0f nodes/s %9.1f MB tree%s", p_result->nodes, nodes_per_s,
+            p_result->tree_bytes / 1e6, p_result->ok ? "" : " (failed)");
+    putchar('\n');
+}
+
+
+int main(int argc, char *argv[]) {
+    if (argc > 1 && !strcmp(argv[1], "--json")) {
+        json = true;
+        argv++;
+        argc--;
+    }
+    if (argc < 2) {
+        fprintf(stderr, "usage: %s [--json] <file> [repeat]\n", argv[0]);
+        return 1;
+    }
+    size_t repeat = argc > 2 ? strtoul(argv[2], NULL, 10) : 1;
+
+    FILE *f = fopen(argv[1], "rb");
+    if (!f) {
+        perror(argv[1]);
+        return 1;
+    }
+    fseek(f, 0, SEEK_END);
+    size_t len = ftell(f);
+    rewind(f);
+    size_t size = len * repeat;
+    char *source = malloc(size + 1);
+    if (fread(source, 1, len, f) != len) {
+        perror(argv[1]);
+        return 1;
+    }
+    fclose(f);
+    for (size_t i = 1; i < repeat; i++)
+        memcpy(source + i * len, source, len);
+    source[size] = '\0';
+
+    Result result = {.bench = "lex", .file = argv[1], .bytes = size, .ok = true};
+
+    FILE *stream = fmemopen(source, size, "rb");
+    Tokenizer *tk = tokenizerInit(get_char, stream, argv[1]);
+    double start = now();
+    result.tokens = lex_all(tk);
+    result.seconds = now() - start;
+    result.mode = "callback";
+    report(&result);
+    tokenizerTerminate(tk);
+    fclose(stream);
+
+    tk = tokenizerInitBuffer(source, size, argv[1]);
+    start = now();
+    result.tokens = lex_all(tk);
+    result.seconds = now() - start;
+    result.mode = "buffer";
+    report(&result);
+    tokenizerTerminate(tk);
+
+    tk = tokenizerInitBuffer(source, size, argv[1]);
+    start = now();
+    tokenizerLexAll(tk);
+    result.tokens = lex_all(tk);
+    result.seconds = now() - start;
+    result.mode = "array";
+    report(&result);
+    tokenizerTerminate(tk);
+
+    // Parsing is timed on its own, over tokens lexed up front
+    tk = tokenizerInitBuffer(source, size, argv[1]);
+    result.tokens = tokenizerLexAll(tk);
+    Parser *pr = parserInit(tk);
+    start = now();
+    result.ok = !parserParse(pr);
+    result.seconds = now() - start;
+    result.nodes = nodeCount(parserGetRoot(pr));
+    result.arena_used = arenaGetUsed(parserGetArena(pr));
+    result.arena_peak = arenaGetPeak(parserGetArena(pr));
+    result.tree_bytes = result.arena_used;
+    result.bench = "parse";
+    result.mode = "array";
+    report(&result);
+
+    // The same tree flattened, then walked in both layouts
+    Node *root = parserGetRoot(pr);
+    start = now();
+    FlatTree *flat = nodeFlatten(root);
+    result.seconds = now() - start;
+    result.tree_bytes = flatTreeGetBytes(flat);
+    result.arena_used = result.arena_peak = 0;
+    result.bench = "flat";
+    result.mode = "build";
+    report(&result);
+
+    start = now();
+    result.nodes = nodeCount(root);
+    result.seconds = now() - start;
+    result.tree_bytes = arenaGetUsed(parserGetArena(pr));
+    result.bench = "walk";
+    result.mode = "pointer";
+    report(&result);
+
+    start = now();
+    result.nodes = root ? flat_count(flat, 0) : 0;
+    result.seconds = now() - start;
+    result.tree_bytes = flatTreeGetBytes(flat);
+    result.mode = "flat";
+    report(&result);
+
+    // Dumps go to /dev/null, what is left is the cost of writing them
+    int null_fd = open("/dev/null", O_WRONLY);
+    static const struct {const char *name; DumpFormat format;} dumps[] = {
+        {"text", DUMP_TEXT}, {"compact", DUMP_COMPACT}
+    };
+    for (size_t i = 0; i < sizeof(dumps) / sizeof(*dumps); i++) {
+        Sink *sink = sinkInit(null_fd, 0);
+        start = now();
+        flatTreeDump(flat, sink, dumps[i].format);
+        result.ok = !sinkTerminate(sink);
+        result.seconds = now() - start;
+        result.bench = "dump";
+        result.mode = dumps[i].name;
+        report(&result);
+    }
+    close(null_fd);
+    flatTreeTerminate(flat);
+    parserTerminate(pr);
+    tokenizerTerminate(tk);
+
+    // Method bodies skipped, lexing included since the skip is what saves it
+    tk = tokenizerInitBuffer(source, size, argv[1]);
+    pr = parserInit(tk);
+    parserSetLazyBodies(pr, true);
+    start = now();
+    result.ok = !parserParse(pr);
+    result.seconds = now() - start;
+    result.nodes = nodeCount(parserGetRoot(pr));
+    result.tokens = 0;
+    result.arena_used = result.tree_bytes = arenaGetUsed(parserGetArena(pr));
+    result.arena_peak = arenaGetPeak(parserGetArena(pr));
+    result.bench = "parse";
+    result.mode = "lazy";
+    report(&result);
+    parserTerminate(pr);
+    tokenizerTerminate(tk);
+
+    // Top level declarations on every core, lexing included as well
+    tk = tokenizerInitBuffer(source, size, argv[1]);
+    pr = parserInit(tk);
+    parserSetThreads(pr, (int)sysconf(_SC_NPROCESSORS_ONLN));
+    start = now();
+    result.ok = !parserParse(pr);
+    result.seconds = now() - start;
+    result.nodes = nodeCount(parserGetRoot(pr));
+    result.arena_used = result.tree_bytes = arenaGetUsed(parserGetArena(pr));
+    result.arena_peak = arenaGetPeak(parserGetArena(pr));
+    result.mode = "threads";
+    report(&result);
+    parserTerminate(pr);
+    tokenizerTerminate(tk);
+
+    // A stream read through the callback like stdin, lexed in line with the parser then on a thread ahead of it
+    for (int pipelined = 0; pipelined < 2; pipelined++) {
+        stream = fmemopen(source, size, "rb");
+        tk = tokenizerInit(get_char, stream, argv[1]);
+        pr = parserInit(tk);
+        start = now();
+        if (pipelined)
+            tokenizerStartLexerThread(tk);
+        result.ok = !parserParse(pr);
+        result.seconds = now() - start;
+        result.nodes = nodeCount(parserGetRoot(pr));
+        result.arena_used = result.tree_bytes = arenaGetUsed(parserGetArena(pr));
+        result.arena_peak = arenaGetPeak(parserGetArena(pr));
+        result.mode = pipelined ? "pipeline" : "stream";
+        report(&result);
+        parserTerminate(pr);
+        tokenizerTerminate(tk);
+        fclose(stream);
+    }
+
+    // A blank line added before a declaration mid file and taken out again, as an editor would
+    const char *mid = size > 1 ? strstr(source + size / 2, "\nlet ") : NULL;
+    Document *document = documentInit(source, size, argv[1]);
+    if (mid && document && documentGetRoot(document)) {
+        size_t edits = 1000, reparsed = 0;
+        uint32_t offset = (uint32_t)(mid - source);
+        start = now();
+        for (size_t i = 0; i < edits && result.ok; i++) {
+            result.ok = !(i % 2 ? documentEdit(document, offset, 1, "", 0) : documentEdit(document, offset, 0, "\n", 1));
+            reparsed += documentGetReparsed(document);
+        }
+        result.seconds = (now() - start) / edits;
+        // Declarations parsed again per edit in place of nodes
+        result.nodes = reparsed / edits;
+        result.tokens = 0;
+        result.bytes = size;
+        result.tree_bytes = result.arena_used = result.arena_peak = 0;
+        result.bench = "edit";
+        result.mode = "document";
+        report(&result);
+    }
+    if (document)
+        documentTerminate(document);
+
+    free(source);
+    return result.ok ? 0 : 1;
+}
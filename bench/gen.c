@@ -0,0 +1,279 @@
+#define _POSIX_C_SOURCE 200809L
+#include "frontend/tokenizer.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+
+/*
+ * Synthetic Rulma corpus generator, writes a file of roughly the requested
+ * size to stdout. Every corpus only uses what the parser accepts so the same
+ * files drive both the tokenizer and the parser benchmarks.
+*/
+
+#define MAX_DEPTH 256
+
+
+typedef struct {
+    const char *name;
+    void (*emit)(FILE*);
+    const char *description;
+} Corpus;
+
+
+static uint32_t seed = 0x2545F491;
+static int ident_max = 12;
+
+
+static uint32_t rng(void) {
+    seed ^= seed << 13;
+    seed ^= seed >> 17;
+    seed ^= seed << 5;
+    return seed;
+}
+
+
+static void indent(FILE *p_out, int p_depth) {
+    for (int i = 0; i < p_depth; i++)
+        fputc('\t', p_out);
+}
+
+
+static void identifier(FILE *p_out) {
+    static const char head[] = "abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWXYZ_";
+    static const char tail[] = "abcdefghijklmnopqrstuvwxyz_0123456789";
+    char name[64];
+    int len;
+    do {
+        len = 1 + rng() % ident_max;
+        name[0] = head[rng() % (sizeof(head) - 1)];
+        for (int i = 1; i < len; i++)
+            name[i] = tail[rng() % (sizeof(tail) - 1)];
+        // Never a lone underscore nor a keyword, those are tokens of their own
+    } while ((len == 1 && name[0] == '_') || tokenizerIdentifierType(name, len) != TK_IDENTIFIER);
+    fwrite(name, 1, len, p_out);
+}
+
+
+static void type_value(FILE *p_out) {
+    static const char *types[] = {"type", "struct", "enum"};
+    fputs(types[rng() % 3], p_out);
+}
+
+
+static void method(FILE *p_out, int p_depth) {
+    indent(p_out, p_depth);
+    fputs("let ", p_out);
+    identifier(p_out);
+    fputc('(', p_out);
+    for (int i = 0, params = rng() % 4; i < params; i++) {
+        if (i)
+            fputs(", ", p_out);
+        identifier(p_out);
+        fputs(": ", p_out);
+        identifier(p_out);
+    }
+    fputs(") ", p_out);
+    if (rng() & 1) {
+        identifier(p_out);
+        fputc(' ', p_out);
+    }
+    fputs("{\n", p_out);
+    for (int i = 0, lets = rng() % 4; i < lets; i++) {
+        indent(p_out, p_depth + 1);
+        fputs("let ", p_out);
+        identifier(p_out);
+        fputs(" = ", p_out);
+        type_value(p_out);
+        fputc('\n', p_out);
+    }
+    indent(p_out, p_depth);
+    fputs("}\n\n", p_out);
+}
+
+
+static void emit_nested(FILE *p_out) {
+    int depth = 1 + rng() % MAX_DEPTH;
+    for (int i = 0; i < depth; i++) {
+        indent(p_out, i);
+        fputs("let ", p_out);
+        identifier(p_out);
+        fputs(" = space {\n", p_out);
+    }
+    method(p_out, depth);
+    for (int i = depth - 1; i >= 0; i--) {
+        indent(p_out, i);
+        fputs("}\n", p_out);
+    }
+    fputc('\n', p_out);
+}
+
+
+static void emit_methods(FILE *p_out) {
+    method(p_out, 0);
+}
+
+
+static void emit_idents(FILE *p_out) {
+    ident_max = 63;
+    method(p_out, 0);
+}
+
+
+static void emit_comments(FILE *p_out) {
+    for (int i = 0, lines = 4 + rng() % 12; i < lines; i++) {
+        fputs("# ", p_out);
+        for (int words = 3 + rng() % 12; words; words--) {
+            identifier(p_out);
+            fputc(' ', p_out);
+        }
+        fputc('\n', p_out);
+    }
+    fputs("let ", p_out);
+    identifier(p_out);
+    fputs(" = ", p_out);
+    type_value(p_out);
+    fputs("\n\n", p_out);
+}
+
+
+static void emit_literals(FILE *p_out) {
+    fputs("let ", p_out);
+    identifier(p_out);
+    fputs(" = ", p_out);
+    switch (rng() % 5) {
+        case 0:
+            fprintf(p_out, "%u", rng());
+            break;
+        case 1:
+            fprintf(p_out, "%u.%u", rng() % 100000, rng() % 1000);
+            break;
+        case 2:
+            fprintf(p_out, "0x%x", rng());
+            break;
+        case 3:
+            fprintf(p_out, "%uu32", rng());
+            break;
+        default:
+            fputc('"', p_out);
+            for (int words = 1 + rng() % 8; words; words--) {
+                identifier(p_out);
+                fputs(words > 1 ? " " : "\\n", p_out);
+            }
+            fputc('"', p_out);
+            break;
+    }
+    fputc('\n', p_out);
+}
+
+
+static void emit_expressions(FILE *p_out) {
+    static const char *operators[] = {
+        "+", "-", "*", "/", "%", "**", "<<", ">>", "&", "|", "^",
+        "<", "<=", ">", ">=", "==", "!=", "and", "or", "&&", "||"
+    };
+    fputs("let ", p_out);
+    identifier(p_out);
+    fputs(" = ", p_out);
+    int groups = 0;
+    for (int terms = 1 + rng() % 4096; terms; terms--) {
+        if (!(rng() % 8))
+            fputs(rng() & 1 ? "-" : "not ", p_out);
+        if (!(rng() % 8)) {
+            fputc('(', p_out);
+            groups++;
+        }
+        if (rng() & 1)
+            identifier(p_out);
+        else
+            fprintf(p_out, "%u", rng() % 1000);
+        if (groups && !(rng() % 4)) {
+            fputc(')', p_out);
+            groups--;
+        }
+        if (terms > 1)
+            fprintf(p_out, " %s ", operators[rng() % (sizeof(operators) / sizeof(*operators))]);
+    }
+    for (; groups; groups--)
+        fputc(')', p_out);
+    fputs("\n\n", p_out);
+}
+
+
+static void emit_mixed(FILE *p_out) {
+    switch (rng() % 4) {
+        case 0:
+            emit_comments(p_out);
+            break;
+        case 1: {
+            int saved = ident_max;
+            ident_max = 1 + rng() % 63;
+            method(p_out, 0);
+            ident_max = saved;
+            break;
+        }
+        default:
+            method(p_out, 0);
+            break;
+    }
+}
+
+
+static const Corpus corpora[] = {
+    {"nested", emit_nested, "deeply nested spaces"},
+    {"methods", emit_methods, "thousands of let methods"},
+    {"idents", emit_idents, "long identifiers"},
+    {"comments", emit_comments, "comment heavy"},
+    {"literals", emit_literals, "literal heavy"},
+    {"expressions", emit_expressions, "long operator chains"},
+    {"mixed", emit_mixed, "a bit of everything"},
+};
+#define CORPUS_COUNT (sizeof(corpora) / sizeof(*corpora))
+
+
+static size_t parse_size(const char *p_str) {
+    char *end;
+    size_t size = strtoull(p_str, &end, 10);
+    switch (*end) {
+        case 'G': case 'g': size <<= 10; __attribute__((fallthrough));
+        case 'M': case 'm': size <<= 10; __attribute__((fallthrough));
+        case 'K': case 'k': size <<= 10; break;
+        default: break;
+    }
+    return size;
+}
+
+
+int main(int argc, char *argv[]) {
+    const Corpus *corpus = NULL;
+    for (size_t i = 0; argc > 1 && i < CORPUS_COUNT; i++)
+        if (!strcmp(argv[1], corpora[i].name))
+            corpus = &corpora[i];
+    if (!corpus || argc < 3) {
+        fprintf(stderr, "usage: %s <corpus> <size>[K|M|G] [seed]\n", argv[0]);
+        for (size_t i = 0; i < CORPUS_COUNT; i++)
+            fprintf(stderr, "  %-10s %s\n", corpora[i].name, corpora[i].description);
+        return 1;
+    }
+    size_t size = parse_size(argv[2]);
+    if (argc > 3)
+        seed = strtoul(argv[3], NULL, 10) | 1;
+
+    // Constructs are never cut, the file ends on the first one past the size
+    char *chunk = NULL;
+    size_t chunk_size = 0;
+    FILE *mem = open_memstream(&chunk, &chunk_size);
+    if (!mem)
+        return 1;
+    for (size_t written = 0; written < size; written += chunk_size) {
+        rewind(mem);
+        corpus->emit(mem);
+        fflush(mem);
+        if (fwrite(chunk, 1, chunk_size, stdout) != chunk_size)
+            return 1;
+    }
+    fclose(mem);
+    free(chunk);
+    return fflush(stdout) ? 1 : 0;
+}
@@ -0,0 +1,73 @@
+#define _POSIX_C_SOURCE 200809L
+#include "extra/interner.h"
+
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define VOCABULARY 65536
+#define LOOKUPS_PER_THREAD 2000000
+
+
+typedef struct {
+    Interner *interner;
+    unsigned seed;
+    size_t lookups;
+    uint64_t checksum;
+} Worker;
+
+
+static char names[VOCABULARY][32];
+static size_t lengths[VOCABULARY];
+
+
+static double now(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+
+static void *work(void *p_worker) {
+    Worker *worker = (Worker*)p_worker;
+    uint32_t x = worker->seed;
+    for (size_t i = 0; i < worker->lookups; i++) {
+        // xorshift, skewed towards the first names like real identifier use
+        x ^= x << 13;
+        x ^= x >> 17;
+        x ^= x << 5;
+        size_t n = (x & 0xFF) < 200 ? (x >> 8) % 4096 : (x >> 8) % VOCABULARY;
+        worker->checksum += internerIntern(worker->interner, names[n], lengths[n]);
+    }
+    return NULL;
+}
+
+
+int main(int argc, char *argv[]) {
+    size_t lookups = argc > 1 ? strtoul(argv[1], NULL, 10) : LOOKUPS_PER_THREAD;
+    for (size_t i = 0; i < VOCABULARY; i++)
+        lengths[i] = snprintf(names[i], sizeof(names[i]), "symbol_%zu_%zx", i, i * 2654435761u);
+
+    const int thread_counts[] = {1, 2, 4, 8, 16};
+    for (size_t t = 0; t < sizeof(thread_counts) / sizeof(*thread_counts); t++) {
+        int threads = thread_counts[t];
+        Interner *interner = internerInit();
+        pthread_t ids[16];
+        Worker workers[16];
+        double start = now();
+        for (int i = 0; i < threads; i++) {
+            workers[i] = (Worker){.interner = interner, .seed = 0x9E3779B9u * (i + 1), .lookups = lookups};
+            pthread_create(&ids[i], NULL, work, &workers[i]);
+        }
+        for (int i = 0; i < threads; i++)
+            pthread_join(ids[i], NULL);
+        double seconds = now() - start;
+        size_t total = lookups * threads;
+        printf("threads %2d %10zu lookups %9.3f ms %12.0f lookups/s %u symbols\n",
+            threads, total, seconds * 1e3, total / seconds, internerGetCount(interner));
+        internerTerminate(interner);
+    }
+    return 0;
+}
@@ -0,0 +1,45 @@
+#define _POSIX_C_SOURCE 200809L
+#include "frontend/tokenizer.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+
+static const char *words[] = {
+    "let", "space", "fn", "self", "value", "count", "index", "struct", "static",
+    "signal", "super", "sum", "sample", "continue", "class_name", "classify",
+    "breakpoint", "buffer", "while", "when", "whence", "and", "another", "a",
+    "elif", "else", "element", "extends", "extent", "preload", "pass", "param",
+    "ret", "result", "trait", "type", "tau", "TAU", "yield", "void", "vector",
+};
+#define WORD_COUNT (sizeof(words) / sizeof(*words))
+#define ROUNDS 2000000
+
+
+static double now(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+
+int main(int argc, char *argv[]) {
+    size_t rounds = argc > 1 ? strtoul(argv[1], NULL, 10) : ROUNDS;
+    size_t lengths[WORD_COUNT];
+    for (size_t i = 0; i < WORD_COUNT; i++)
+        lengths[i] = strlen(words[i]);
+
+    size_t keywords = 0;
+    double start = now();
+    for (size_t r = 0; r < rounds; r++)
+        for (size_t i = 0; i < WORD_COUNT; i++)
+            keywords += tokenizerIdentifierType(words[i], lengths[i]) != TK_IDENTIFIER;
+    double seconds = now() - start;
+
+    size_t lookups = rounds * WORD_COUNT;
+    printf("%zu lookups (%zu keywords) %.3f ms %.2f ns/lookup %.0f lookups/s\n",
+        lookups, keywords, seconds * 1e3, seconds * 1e9 / lookups, lookups / seconds);
+    return 0;
+}
@@ -0,0 +1,399 @@
+#define _XOPEN_SOURCE 700
+#include "driver.h"
+#include "../extra/pool.h"
+#include "../extra/trace.h"
+#include "../frontend/tokenizer.h"
+#include "../frontend/parser.h"
+#include "../syntax_tree/tree_cache.h"
+#include "module_cache.h"
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <dirent.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#define SOURCE_EXTENSION ".rl"
+
+
+typedef struct {
+    DriverFile file;
+    // The tree belongs to the module cache
+    bool shared;
+    bool done;
+} Result;
+
+
+typedef struct {
+    Arena *arena;
+    size_t cached;
+} Worker;
+
+
+struct Driver {
+    int threads;
+    TreeCache *cache;
+    ModuleCache *modules;
+    bool lazy_bodies;
+    char **paths;
+    size_t count;
+    size_t capacity;
+    Result *results;
+    Worker *workers;
+    // The result the calling thread waits for, SIZE_MAX when it does not
+    size_t waiting;
+    pthread_mutex_t mutex;
+    pthread_cond_t cond;
+    DriverStats stats;
+};
+
+
+static double _now(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+
+static void _add_file(Driver *p_driver, const char *p_path) {
+    if (p_driver->count == p_driver->capacity) {
+        size_t capacity = p_driver->capacity ? p_driver->capacity * 2 : 64;
+        char **grown = (char**)realloc(p_driver->paths, capacity * sizeof(char*));
+        if (!grown)
+            abort();
+        p_driver->paths = grown;
+        p_driver->capacity = capacity;
+    }
+    char *path = strdup(p_path);
+    if (!path)
+        abort();
+    p_driver->paths[p_driver->count++] = path;
+}
+
+
+static int _compare_names(const void *p_a, const void *p_b) {
+    return strcmp(*(char *const*)p_a, *(char *const*)p_b);
+}
+
+
+static bool _is_source(const char *p_name) {
+    size_t length = strlen(p_name), extension = strlen(SOURCE_EXTENSION);
+    return length > extension && !strcmp(p_name + length - extension, SOURCE_EXTENSION);
+}
+
+
+/*
+ * Every source file under p_dir, entries sorted by name so the files come
+ * in the same order on every run. Hidden entries and symbolic links to
+ * directories are left out.
+*/
+static int _add_dir(Driver *p_driver, const char *p_dir) {
+    DIR *dir = opendir(p_dir);
+    if (!dir)
+        return -1;
+    char **names = NULL;
+    size_t count = 0, capacity = 0;
+    struct dirent *entry;
+    while ((entry = readdir(dir))) {
+        if (entry->d_name[0] == '.')
+            continue;
+        if (count == capacity) {
+            capacity = capacity ? capacity * 2 : 16;
+            char **grown = (char**)realloc(names, capacity * sizeof(char*));
+            if (!grown)
+                abort();
+            names = grown;
+        }
+        if (!(names[count++] = strdup(entry->d_name)))
+            abort();
+    }
+    closedir(dir);
+    qsort(names, count, sizeof(char*), _compare_names);
+
+    int status = 0;
+    size_t dir_length = strlen(p_dir);
+    for (size_t i = 0; i < count; i++) {
+        size_t length = dir_length + 1 + strlen(names[i]) + 1;
+        char *path = (char*)malloc(length);
+        if (!path)
+            abort();
+        snprintf(path, length, "%s/%s", p_dir, names[i]);
+        struct stat st;
+        if (lstat(path, &st)) {
+            status = -1;
+        } else if (S_ISDIR(st.st_mode)) {
+            if (_add_dir(p_driver, path))
+                status = -1;
+        } else if (_is_source(names[i])) {
+            _add_file(p_driver, path);
+        }
+        free(path);
+        free(names[i]);
+    }
+    free(names);
+    return status;
+}
+
+
+/*
+ * One file start to end on the thread's own arena, which is reset for the
+ * next. Errors are not printed here, the files would mix their messages.
+*/
+static void _compile(void *p_driver, size_t p_task, int p_thread) {
+    Driver *driver = (Driver*)p_driver;
+    Worker *worker = &driver->workers[p_thread];
+    Result *result = &driver->results[p_task];
+    DriverFile *file = &result->file;
+    uint64_t start = traceBegin();
+
+    // Kept in memory by absolute path, an unchanged file is not even opened
+    struct stat st;
+    char *module = NULL;
+    if (driver->modules && !stat(file->path, &st) && (module = realpath(file->path, NULL))) {
+        if ((file->tree = moduleCacheFind(driver->modules, module, &st))) {
+            file->bytes = st.st_size;
+            result->shared = true;
+            worker->cached++;
+            goto done;
+        }
+    }
+
+    Tokenizer *tk = tokenizerInitFile(file->path);
+    if (!tk) {
+        file->status = -1;
+        file->error = errno;
+        goto done;
+    }
+    const char *source = tokenizerGetBuffer(tk, &file->bytes);
+    uint64_t key = (module || driver->cache) && source ? treeCacheKey(source, file->bytes) : 0;
+    if (module && (file->tree = moduleCacheFindContent(driver->modules, module, &st, key, file->bytes))) {
+        result->shared = true;
+        worker->cached++;
+        tokenizerTerminate(tk);
+        goto done;
+    }
+    FlatTree *tree = driver->cache && source ? treeCacheLoad(driver->cache, key, file->bytes) : NULL;
+    if (tree) {
+        worker->cached++;
+    } else {
+        // Skipped bodies are skipped on the text, lexing them first would undo the saving
+        if (!driver->lazy_bodies)
+            tokenizerLexAll(tk);
+        Parser *parser = parserInitArena(tk, worker->arena);
+        parserSetQuiet(parser, true);
+        parserSetLazyBodies(parser, driver->lazy_bodies);
+        file->status = parserParse(parser);
+        if (!file->status) {
+            tree = nodeFlatten(parserGetRoot(parser));
+            // A skipped body that failed fails the file, _report parses it again in full
+            if (parserGetBodyErrors(parser)) {
+                flatTreeTerminate(tree);
+                tree = NULL;
+                file->status = -1;
+            } else if (driver->cache && source) {
+                treeCacheStore(driver->cache, key, file->bytes, tree);
+            }
+        }
+        parserTerminate(parser);
+        arenaReset(worker->arena);
+    }
+    tokenizerTerminate(tk);
+    if (tree && module) {
+        file->tree = moduleCacheStore(driver->modules, module, &st, key, file->bytes, tree);
+        result->shared = true;
+    } else {
+        file->tree = tree;
+    }
+
+    done:
+        free(module);
+        traceEnd("Compile", file->path, start);
+        pthread_mutex_lock(&driver->mutex);
+        result->done = true;
+        if (driver->waiting == p_task)
+            pthread_cond_signal(&driver->cond);
+        pthread_mutex_unlock(&driver->mutex);
+}
+
+
+/*
+ * The file parsed again, loud this time, for its errors to come out where
+ * its output would have been.
+*/
+static void _report(const DriverFile *p_file) {
+    if (p_file->error) {
+        fflush(stdout);
+        fprintf(stderr, "%s: %s\n", p_file->path, strerror(p_file->error));
+        return;
+    }
+    Tokenizer *tk = tokenizerInitFile(p_file->path);
+    if (!tk)
+        return;
+    Parser *parser = parserInit(tk);
+    parserParse(parser);
+    parserTerminate(parser);
+    tokenizerTerminate(tk);
+    fflush(stdout);
+}
+
+
+/*
+ * p_threads below 1 is one per core.
+*/
+Driver *driverInit(int p_threads) {
+    Driver *driver = (Driver*)calloc(1, sizeof(Driver));
+    if (!driver)
+        return NULL;
+    if (p_threads < 1) {
+        long cores = sysconf(_SC_NPROCESSORS_ONLN);
+        p_threads = cores > 0 ? (int)cores : 1;
+    }
+    driver->threads = p_threads;
+    driver->waiting = SIZE_MAX;
+    pthread_mutex_init(&driver->mutex, NULL);
+    pthread_cond_init(&driver->cond, NULL);
+    return driver;
+}
+
+
+/*
+ * Trees are then looked up and stored in p_cache, shared by every thread,
+ * as with a single file.
+*/
+void driverSetCache(Driver *p_driver, TreeCache *p_cache) {
+    p_driver->cache = p_cache;
+}
+
+
+/*
+ * Trees are then kept in p_modules, which outlives the driver, and looked
+ * up there first.
+*/
+void driverSetModules(Driver *p_driver, ModuleCache *p_modules) {
+    p_driver->modules = p_modules;
+}
+
+
+/*
+ * Method bodies are then skipped while parsing and parsed as the tree is
+ * flattened (parserSetLazyBodies), the trees come out the same.
+*/
+void driverSetLazyBodies(Driver *p_driver, bool p_lazy) {
+    p_driver->lazy_bodies = p_lazy;
+}
+
+
+/*
+ * A file is taken whatever its name, a directory for the source files
+ * anywhere under it.
+*/
+int driverAddPath(Driver *p_driver, const char *p_path) {
+    struct stat st;
+    if (stat(p_path, &st))
+        return -1;
+    if (S_ISDIR(st.st_mode))
+        return _add_dir(p_driver, p_path);
+    _add_file(p_driver, p_path);
+    return 0;
+}
+
+
+size_t driverGetFileCount(const Driver *p_driver) {
+    return p_driver->count;
+}
+
+
+/*
+ * Compiles every file added so far. p_output is called on this thread for
+ * each of them in order as soon as it and all before it are done, the tree
+ * is freed right after unless the module cache keeps it. Returns how many files failed.
+*/
+size_t driverRun(Driver *p_driver, DriverOutput p_output, void *p_ctx) {
+    double start = _now();
+    size_t count = p_driver->count;
+    p_driver->results = (Result*)calloc(count ? count : 1, sizeof(Result));
+    int threads = (size_t)p_driver->threads < count ? p_driver->threads : (count ? (int)count : 1);
+    p_driver->workers = (Worker*)calloc(threads, sizeof(Worker));
+    if (!p_driver->results || !p_driver->workers)
+        abort();
+    for (size_t i = 0; i < count; i++)
+        p_driver->results[i].file.path = p_driver->paths[i];
+    for (int i = 0; i < threads; i++)
+        if (!(p_driver->workers[i].arena = arenaInit(0)))
+            abort();
+
+    // Results are waited for below before poolWait, no thread to run them would hang
+    Pool *pool = poolInit(threads, count, _compile, p_driver);
+    if (!pool)
+        abort();
+    size_t failed = 0, bytes = 0;
+    for (size_t i = 0; i < count; i++) {
+        Result *result = &p_driver->results[i];
+        pthread_mutex_lock(&p_driver->mutex);
+        p_driver->waiting = i;
+        while (!result->done)
+            pthread_cond_wait(&p_driver->cond, &p_driver->mutex);
+        p_driver->waiting = SIZE_MAX;
+        pthread_mutex_unlock(&p_driver->mutex);
+
+        if (result->file.status) {
+            failed++;
+            uint64_t start = traceBegin();
+            _report(&result->file);
+            traceEnd("Report", result->file.path, start);
+        }
+        bytes += result->file.bytes;
+        if (p_output) {
+            uint64_t start = traceBegin();
+            p_output(p_ctx, &result->file);
+            traceEnd("Output", result->file.path, start);
+        }
+        if (result->file.tree && !result->shared)
+            flatTreeTerminate((FlatTree*)result->file.tree);
+        result->file.tree = NULL;
+    }
+    poolWait(pool);
+    if (p_driver->modules)
+        moduleCacheCollect(p_driver->modules);
+
+    DriverStats *stats = &p_driver->stats;
+    stats->files += count;
+    stats->failed += failed;
+    stats->bytes += bytes;
+    stats->steals += poolGetSteals(pool);
+    stats->threads = threads;
+    poolTerminate(pool);
+    for (int i = 0; i < threads; i++) {
+        stats->cached += p_driver->workers[i].cached;
+        arenaTerminate(p_driver->workers[i].arena);
+    }
+    free(p_driver->workers);
+    free(p_driver->results);
+    p_driver->workers = NULL;
+    p_driver->results = NULL;
+    stats->seconds += _now() - start;
+    return failed;
+}
+
+
+/*
+ * Totals over every run so far.
+*/
+DriverStats driverGetStats(const Driver *p_driver) {
+    return p_driver->stats;
+}
+
+
+void driverTerminate(Driver *p_driver) {
+    for (size_t i = 0; i < p_driver->count; i++)
+        free(p_driver->paths[i]);
+    free(p_driver->paths);
+    pthread_mutex_destroy(&p_driver->mutex);
+    pthread_cond_destroy(&p_driver->cond);
+    free(p_driver);
+}
@@ -0,0 +1,53 @@
+#ifndef DRIVER_H
+#define DRIVER_H
+
+#include "../syntax_tree/flat_tree.h"
+#include "../syntax_tree/tree_cache.h"
+#include "module_cache.h"
+
+#include <stdbool.h>
+#include <stddef.h>
+
+/*
+ * The frontend over many files at once. Every file is a task of a work
+ * stealing pool, each thread has an arena of its own and a tokenizer per
+ * file. Results come back on the calling thread in the order the files were
+ * added, whatever order they finished in.
+*/
+typedef struct Driver Driver;
+
+typedef struct {
+    const char *path;
+    size_t bytes;
+    // parserParse's status, also not 0 when the file could not be read
+    int status;
+    // errno of a file that could not be read, 0 otherwise
+    int error;
+    // NULL unless status is 0
+    const FlatTree *tree;
+} DriverFile;
+
+typedef struct {
+    size_t files;
+    size_t failed;
+    size_t bytes;
+    size_t cached;
+    size_t steals;
+    int threads;
+    double seconds;
+} DriverStats;
+
+typedef void (*DriverOutput)(void *p_ctx, const DriverFile *p_file);
+
+
+Driver *driverInit(int p_threads);
+void driverSetCache(Driver *p_driver, TreeCache *p_cache);
+void driverSetModules(Driver *p_driver, ModuleCache *p_modules);
+void driverSetLazyBodies(Driver *p_driver, bool p_lazy);
+int driverAddPath(Driver *p_driver, const char *p_path);
+size_t driverGetFileCount(const Driver *p_driver);
+size_t driverRun(Driver *p_driver, DriverOutput p_output, void *p_ctx);
+DriverStats driverGetStats(const Driver *p_driver);
+void driverTerminate(Driver *p_driver);
+
+#endif // DRIVER_H
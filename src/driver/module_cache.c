@@ -0,0 +1,192 @@
+#define _POSIX_C_SOURCE 200809L
+#include "module_cache.h"
+#include "../extra/hash.h"
+
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <pthread.h>
+
+#define INITIAL_CAPACITY 256
+// A file written this close to when it was cached may change again within the same mtime
+#define RACY_SECONDS 2
+
+
+typedef struct {
+    char *path;
+    uint32_t path_hash;
+    struct timespec mtime;
+    off_t size;
+    // Of the text the tree was parsed from, both compared as a hash alone may collide
+    uint64_t hash;
+    size_t bytes;
+    // Whether an unchanged mtime and size are enough to trust the tree
+    bool settled;
+    FlatTree *tree;
+} Entry;
+
+
+struct ModuleCache {
+    pthread_mutex_t mutex;
+    Entry *entries;
+    size_t capacity;
+    size_t count;
+    FlatTree **retired;
+    size_t retired_count;
+    size_t retired_capacity;
+};
+
+
+static bool _same_stat(const Entry *p_entry, const struct stat *p_stat) {
+    return p_entry->size == p_stat->st_size && p_entry->mtime.tv_sec == p_stat->st_mtim.tv_sec
+        && p_entry->mtime.tv_nsec == p_stat->st_mtim.tv_nsec;
+}
+
+
+static Entry *_slot(const ModuleCache *p_cache, const char *p_path, uint32_t p_hash) {
+    size_t mask = p_cache->capacity - 1;
+    for (size_t i = p_hash & mask;; i = (i + 1) & mask) {
+        Entry *entry = &p_cache->entries[i];
+        if (!entry->path || (entry->path_hash == p_hash && !strcmp(entry->path, p_path)))
+            return entry;
+    }
+}
+
+
+static void _grow(ModuleCache *p_cache) {
+    Entry *old = p_cache->entries;
+    size_t old_capacity = p_cache->capacity;
+    p_cache->capacity *= 2;
+    p_cache->entries = (Entry*)calloc(p_cache->capacity, sizeof(Entry));
+    if (!p_cache->entries)
+        abort();
+    for (size_t i = 0; i < old_capacity; i++)
+        if (old[i].path)
+            *_slot(p_cache, old[i].path, old[i].path_hash) = old[i];
+    free(old);
+}
+
+
+static void _retire(ModuleCache *p_cache, FlatTree *p_tree) {
+    if (p_cache->retired_count == p_cache->retired_capacity) {
+        size_t capacity = p_cache->retired_capacity ? p_cache->retired_capacity * 2 : 16;
+        FlatTree **grown = (FlatTree**)realloc(p_cache->retired, capacity * sizeof(FlatTree*));
+        if (!grown)
+            abort();
+        p_cache->retired = grown;
+        p_cache->retired_capacity = capacity;
+    }
+    p_cache->retired[p_cache->retired_count++] = p_tree;
+}
+
+
+static void _set_stat(Entry *p_entry, const struct stat *p_stat) {
+    p_entry->mtime = p_stat->st_mtim;
+    p_entry->size = p_stat->st_size;
+    p_entry->settled = p_stat->st_mtim.tv_sec < time(NULL) - RACY_SECONDS;
+}
+
+
+ModuleCache *moduleCacheInit(void) {
+    ModuleCache *cache = (ModuleCache*)calloc(1, sizeof(ModuleCache));
+    if (!cache)
+        return NULL;
+    cache->capacity = INITIAL_CAPACITY;
+    cache->entries = (Entry*)calloc(cache->capacity, sizeof(Entry));
+    if (!cache->entries) {
+        free(cache);
+        return NULL;
+    }
+    pthread_mutex_init(&cache->mutex, NULL);
+    return cache;
+}
+
+
+/*
+ * The tree of p_path if neither its size nor its mtime moved since.
+*/
+const FlatTree *moduleCacheFind(ModuleCache *p_cache, const char *p_path, const struct stat *p_stat) {
+    uint32_t path_hash = hashWords(p_path, strlen(p_path));
+    pthread_mutex_lock(&p_cache->mutex);
+    Entry *entry = _slot(p_cache, p_path, path_hash);
+    const FlatTree *tree = entry->path && entry->settled && _same_stat(entry, p_stat) ? entry->tree : NULL;
+    pthread_mutex_unlock(&p_cache->mutex);
+    return tree;
+}
+
+
+/*
+ * The tree of p_path if its text is still as long and hashes to the same,
+ * the new stat is then remembered.
+*/
+const FlatTree *moduleCacheFindContent(ModuleCache *p_cache, const char *p_path, const struct stat *p_stat, uint64_t p_hash, size_t p_bytes) {
+    uint32_t path_hash = hashWords(p_path, strlen(p_path));
+    pthread_mutex_lock(&p_cache->mutex);
+    Entry *entry = _slot(p_cache, p_path, path_hash);
+    const FlatTree *tree = NULL;
+    if (entry->path && entry->hash == p_hash && entry->bytes == p_bytes) {
+        _set_stat(entry, p_stat);
+        tree = entry->tree;
+    }
+    pthread_mutex_unlock(&p_cache->mutex);
+    return tree;
+}
+
+
+/*
+ * Takes p_tree over and returns it, the tree it replaces is retired.
+*/
+const FlatTree *moduleCacheStore(ModuleCache *p_cache, const char *p_path, const struct stat *p_stat, uint64_t p_hash, size_t p_bytes, FlatTree *p_tree) {
+    uint32_t path_hash = hashWords(p_path, strlen(p_path));
+    pthread_mutex_lock(&p_cache->mutex);
+    if ((p_cache->count + 1) * 2 > p_cache->capacity)
+        _grow(p_cache);
+    Entry *entry = _slot(p_cache, p_path, path_hash);
+    if (entry->path) {
+        _retire(p_cache, entry->tree);
+    } else {
+        if (!(entry->path = strdup(p_path)))
+            abort();
+        entry->path_hash = path_hash;
+        p_cache->count++;
+    }
+    _set_stat(entry, p_stat);
+    entry->hash = p_hash;
+    entry->bytes = p_bytes;
+    entry->tree = p_tree;
+    pthread_mutex_unlock(&p_cache->mutex);
+    return p_tree;
+}
+
+
+/*
+ * Frees the trees replaced so far, none of them may be in use anymore.
+*/
+void moduleCacheCollect(ModuleCache *p_cache) {
+    pthread_mutex_lock(&p_cache->mutex);
+    for (size_t i = 0; i < p_cache->retired_count; i++)
+        flatTreeTerminate(p_cache->retired[i]);
+    p_cache->retired_count = 0;
+    pthread_mutex_unlock(&p_cache->mutex);
+}
+
+
+size_t moduleCacheGetCount(const ModuleCache *p_cache) {
+    return p_cache->count;
+}
+
+
+void moduleCacheTerminate(ModuleCache *p_cache) {
+    moduleCacheCollect(p_cache);
+    for (size_t i = 0; i < p_cache->capacity; i++) {
+        if (!p_cache->entries[i].path)
+            continue;
+        free(p_cache->entries[i].path);
+        flatTreeTerminate(p_cache->entries[i].tree);
+    }
+    free(p_cache->entries);
+    free(p_cache->retired);
+    pthread_mutex_destroy(&p_cache->mutex);
+    free(p_cache);
+}
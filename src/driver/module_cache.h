@@ -0,0 +1,28 @@
+#ifndef MODULE_CACHE_H
+#define MODULE_CACHE_H
+
+#include "../syntax_tree/flat_tree.h"
+
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/stat.h>
+
+/*
+ * Trees kept in memory for as long as the process lives, by absolute path.
+ * A file whose size and mtime did not change is not even read again; one
+ * that was touched but holds the same text is read and hashed but not
+ * parsed. Safe to share between threads. A tree that gets replaced stays
+ * valid until moduleCacheCollect, so whoever found it can still use it.
+*/
+typedef struct ModuleCache ModuleCache;
+
+
+ModuleCache *moduleCacheInit(void);
+const FlatTree *moduleCacheFind(ModuleCache *p_cache, const char *p_path, const struct stat *p_stat);
+const FlatTree *moduleCacheFindContent(ModuleCache *p_cache, const char *p_path, const struct stat *p_stat, uint64_t p_hash, size_t p_bytes);
+const FlatTree *moduleCacheStore(ModuleCache *p_cache, const char *p_path, const struct stat *p_stat, uint64_t p_hash, size_t p_bytes, FlatTree *p_tree);
+void moduleCacheCollect(ModuleCache *p_cache);
+size_t moduleCacheGetCount(const ModuleCache *p_cache);
+void moduleCacheTerminate(ModuleCache *p_cache);
+
+#endif // MODULE_CACHE_H
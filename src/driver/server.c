@@ -0,0 +1,300 @@
+#define _POSIX_C_SOURCE 200809L
+#include "server.h"
+#include "../extra/trace.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <sys/un.h>
+
+// Bumped whenever a request or its answer changes shape
+#define SERVER_MAGIC 0x726c7301
+#define MAX_REQUEST_SIZE (64 * 1024 * 1024)
+#define CLIENT_FDS 2
+// Requests are served one at a time, a client that stalls longer is dropped
+#define CLIENT_TIMEOUT_SECONDS 5
+
+
+/*
+ * Sent along with the client's stdout and stderr, followed by size bytes of
+ * NUL terminated strings: the working directory then count paths.
+*/
+typedef struct {
+    uint32_t magic;
+    uint32_t size;
+    int32_t format;
+    int32_t threads;
+    uint32_t count;
+} Request;
+
+
+static volatile sig_atomic_t stopping = 0;
+
+
+static void _stop(int p_signal) {
+    (void)p_signal;
+    stopping = 1;
+}
+
+
+static int _write_all(int p_fd, const void *p_data, size_t p_size) {
+    for (const char *c = (const char*)p_data; p_size;) {
+        ssize_t n = write(p_fd, c, p_size);
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n <= 0)
+            return -1;
+        c += n;
+        p_size -= n;
+    }
+    return 0;
+}
+
+
+static int _read_all(int p_fd, void *p_data, size_t p_size) {
+    for (char *c = (char*)p_data; p_size;) {
+        ssize_t n = read(p_fd, c, p_size);
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n <= 0)
+            return -1;
+        c += n;
+        p_size -= n;
+    }
+    return 0;
+}
+
+
+static int _address(const char *p_socket, struct sockaddr_un *p_address) {
+    memset(p_address, 0, sizeof(*p_address));
+    p_address->sun_family = AF_UNIX;
+    if (strlen(p_socket) >= sizeof(p_address->sun_path)) {
+        errno = ENAMETOOLONG;
+        return -1;
+    }
+    strcpy(p_address->sun_path, p_socket);
+    return 0;
+}
+
+
+/*
+ * The header and the client's descriptors, which come in the same message.
+*/
+static int _receive_header(int p_client, Request *p_request, int p_fds[CLIENT_FDS]) {
+    union {
+        char buffer[CMSG_SPACE(CLIENT_FDS * sizeof(int))];
+        struct cmsghdr align;
+    } control;
+    memset(&control, 0, sizeof(control));
+    struct iovec iov = {p_request, sizeof(Request)};
+    struct msghdr message = {
+        .msg_iov = &iov,
+        .msg_iovlen = 1,
+        .msg_control = control.buffer,
+        .msg_controllen = sizeof(control.buffer),
+    };
+    ssize_t n;
+    do {
+        n = recvmsg(p_client, &message, MSG_WAITALL);
+    } while (n < 0 && errno == EINTR);
+    // Nothing came, msg_controllen was never set
+    if (n < 0)
+        return -1;
+    struct cmsghdr *header = CMSG_FIRSTHDR(&message);
+    if (!header || header->cmsg_level != SOL_SOCKET || header->cmsg_type != SCM_RIGHTS
+            || header->cmsg_len != CMSG_LEN(CLIENT_FDS * sizeof(int)))
+        return -1;
+    memcpy(p_fds, CMSG_DATA(header), CLIENT_FDS * sizeof(int));
+    // A request without paths would leave the compile nothing to look at. Each
+    // path takes a byte at least, more of them than bytes cannot be right
+    if (n != sizeof(Request) || p_request->magic != SERVER_MAGIC || p_request->size > MAX_REQUEST_SIZE
+            || !p_request->count || p_request->count > p_request->size) {
+        close(p_fds[0]);
+        close(p_fds[1]);
+        return -1;
+    }
+    return 0;
+}
+
+
+/*
+ * One request from start to end, stdout and stderr are the client's while
+ * it lasts.
+*/
+static void _serve(int p_client, ServerCompile p_compile, void *p_ctx) {
+    Request request;
+    int fds[CLIENT_FDS];
+    if (_receive_header(p_client, &request, fds))
+        return;
+    char *strings = (char*)malloc(request.size + 1);
+    char **paths = (char**)malloc((request.count + 1) * sizeof(char*));
+    if (!strings || !paths)
+        abort();
+    int32_t status = 1;
+    if (_read_all(p_client, strings, request.size))
+        goto done;
+    strings[request.size] = '\0';
+    // The working directory, then the paths
+    char *c = strings, *end = strings + request.size;
+    uint32_t count = 0;
+    for (; c < end && count <= request.count; c += strlen(c) + 1)
+        paths[count++] = c;
+    if (c != end || count != request.count + 1)
+        goto done;
+
+    fflush(stdout);
+    fflush(stderr);
+    int saved_out = dup(STDOUT_FILENO), saved_err = dup(STDERR_FILENO);
+    dup2(fds[0], STDOUT_FILENO);
+    dup2(fds[1], STDERR_FILENO);
+    uint64_t start = traceBegin();
+    // Back here after the request, whatever the server resolves relative to its own directory stays put
+    int home = open(".", O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (home < 0 || chdir(paths[0]))
+        perror(home < 0 ? "." : paths[0]);
+    else
+        status = p_compile(p_ctx, paths + 1, (int)request.count, (DumpFormat)request.format, request.threads);
+    if (home >= 0) {
+        if (fchdir(home))
+            perror("fchdir");
+        close(home);
+    }
+    traceEnd("Request", paths[0], start);
+    fflush(stdout);
+    fflush(stderr);
+    dup2(saved_out, STDOUT_FILENO);
+    dup2(saved_err, STDERR_FILENO);
+    close(saved_out);
+    close(saved_err);
+    _write_all(p_client, &status, sizeof(status));
+
+    done:
+        close(fds[0]);
+        close(fds[1]);
+        free(paths);
+        free(strings);
+}
+
+
+/*
+ * Serves requests on p_socket until SIGINT or SIGTERM. A socket left behind
+ * by a server that is gone is taken over, one that still answers is not.
+*/
+int serverListen(const char *p_socket, ServerCompile p_compile, void *p_ctx) {
+    struct sockaddr_un address;
+    if (_address(p_socket, &address))
+        return -1;
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0)
+        return -1;
+    if (!connect(fd, (struct sockaddr*)&address, sizeof(address))) {
+        close(fd);
+        errno = EADDRINUSE;
+        return -1;
+    }
+    close(fd);
+    unlink(p_socket);
+    if ((fd = socket(AF_UNIX, SOCK_STREAM, 0)) < 0)
+        return -1;
+    if (bind(fd, (struct sockaddr*)&address, sizeof(address)) || listen(fd, SOMAXCONN)) {
+        close(fd);
+        return -1;
+    }
+
+    // No SA_RESTART, a signal has to get accept out of its wait
+    struct sigaction action = {.sa_handler = _stop};
+    sigemptyset(&action.sa_mask);
+    sigaction(SIGINT, &action, NULL);
+    sigaction(SIGTERM, &action, NULL);
+    // A client gone mid answer is no reason to die
+    signal(SIGPIPE, SIG_IGN);
+
+    while (!stopping) {
+        int client = accept(fd, NULL, NULL);
+        if (client < 0) {
+            if (errno == EINTR || errno == ECONNABORTED)
+                continue;
+            break;
+        }
+        struct timeval timeout = {.tv_sec = CLIENT_TIMEOUT_SECONDS};
+        if (!setsockopt(client, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout)))
+            _serve(client, p_compile, p_ctx);
+        close(client);
+    }
+    close(fd);
+    unlink(p_socket);
+    return 0;
+}
+
+
+/*
+ * Has the server on p_socket compile p_paths as this process would. Returns
+ * -1 when no server could be reached, nothing was done then; otherwise
+ * p_status is the exit status of the request.
+*/
+int serverSubmit(const char *p_socket, char *p_paths[], int p_count, DumpFormat p_format, int p_threads, int *p_status) {
+    struct sockaddr_un address;
+    if (_address(p_socket, &address))
+        return -1;
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0)
+        return -1;
+    if (connect(fd, (struct sockaddr*)&address, sizeof(address))) {
+        close(fd);
+        return -1;
+    }
+
+    size_t cwd_capacity = 256;
+    char *cwd = (char*)malloc(cwd_capacity);
+    while (cwd && !getcwd(cwd, cwd_capacity) && errno == ERANGE) {
+        char *grown = (char*)realloc(cwd, cwd_capacity *= 2);
+        if (!grown)
+            free(cwd);
+        cwd = grown;
+    }
+    if (!cwd)
+        abort();
+    size_t size = strlen(cwd) + 1;
+    for (int i = 0; i < p_count; i++)
+        size += strlen(p_paths[i]) + 1;
+    Request request = {SERVER_MAGIC, (uint32_t)size, p_format, p_threads, (uint32_t)p_count};
+
+    union {
+        char buffer[CMSG_SPACE(CLIENT_FDS * sizeof(int))];
+        struct cmsghdr align;
+    } control;
+    memset(&control, 0, sizeof(control));
+    struct iovec iov = {&request, sizeof(request)};
+    struct msghdr message = {
+        .msg_iov = &iov,
+        .msg_iovlen = 1,
+        .msg_control = control.buffer,
+        .msg_controllen = sizeof(control.buffer),
+    };
+    struct cmsghdr *header = CMSG_FIRSTHDR(&message);
+    header->cmsg_level = SOL_SOCKET;
+    header->cmsg_type = SCM_RIGHTS;
+    header->cmsg_len = CMSG_LEN(CLIENT_FDS * sizeof(int));
+    int fds[CLIENT_FDS] = {STDOUT_FILENO, STDERR_FILENO};
+    memcpy(CMSG_DATA(header), fds, sizeof(fds));
+
+    int32_t status = 1;
+    int failed = sendmsg(fd, &message, 0) != sizeof(request) || _write_all(fd, cwd, strlen(cwd) + 1);
+    for (int i = 0; i < p_count && !failed; i++)
+        failed = _write_all(fd, p_paths[i], strlen(p_paths[i]) + 1);
+    if (failed || _read_all(fd, &status, sizeof(status))) {
+        fprintf(stderr, "%s: server went away\n", p_socket);
+        status = 1;
+    }
+    free(cwd);
+    close(fd);
+    *p_status = status;
+    return 0;
+}
@@ -0,0 +1,20 @@
+#ifndef SERVER_H
+#define SERVER_H
+
+#include "../syntax_tree/flat_tree.h"
+
+/*
+ * A long lived process that compiles on behalf of thin clients, over a Unix
+ * socket. A client hands over its working directory, its paths and its
+ * stdout and stderr, the server compiles as if it were the client and
+ * answers with the exit status. Requests are served one at a time, each on
+ * every core, with whatever the server kept from the previous ones.
+*/
+
+typedef int (*ServerCompile)(void *p_ctx, char *p_paths[], int p_count, DumpFormat p_format, int p_threads);
+
+
+int serverListen(const char *p_socket, ServerCompile p_compile, void *p_ctx);
+int serverSubmit(const char *p_socket, char *p_paths[], int p_count, DumpFormat p_format, int p_threads, int *p_status);
+
+#endif // SERVER_H
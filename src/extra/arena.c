@@ -0,0 +1,136 @@
+#include "arena.h"
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define DEFAULT_BLOCK_SIZE (64 * 1024)
+
+
+typedef struct Block Block;
+struct Block {
+    Block *prev;
+    size_t size;
+    size_t used;
+    _Alignas(max_align_t) char data[];
+};
+
+
+struct Arena {
+    Block *current;
+    size_t block_size;
+    size_t used;
+    size_t peak;
+};
+
+
+static Block *_create_block(Block *p_prev, size_t p_size) {
+    Block *block = (Block*)malloc(sizeof(Block) + p_size);
+    if (!block)
+        return NULL;
+    block->prev = p_prev;
+    block->size = p_size;
+    block->used = 0;
+    return block;
+}
+
+
+Arena *arenaInit(size_t p_block_size) {
+    Arena *arena = (Arena*)malloc(sizeof(Arena));
+    if (!arena)
+        return NULL;
+    arena->block_size = p_block_size ? p_block_size : DEFAULT_BLOCK_SIZE;
+    arena->used = 0;
+    arena->peak = 0;
+    arena->current = _create_block(NULL, arena->block_size);
+    if (!arena->current) {
+        free(arena);
+        return NULL;
+    }
+    return arena;
+}
+
+
+void *arenaAllocAligned(Arena *p_arena, size_t p_size, size_t p_align) {
+    Block *block = p_arena->current;
+    size_t offset = (block->used + p_align - 1) & ~(p_align - 1);
+    if (offset + p_size > block->size) {
+        // Oversized requests get a block of their own
+        size_t size = p_size + p_align > p_arena->block_size ? p_size + p_align : p_arena->block_size;
+        block = _create_block(block, size);
+        if (!block)
+            return NULL;
+        p_arena->current = block;
+        offset = 0;
+    }
+    // Alignment padding counts as used, it is gone until the next reset
+    p_arena->used += offset + p_size - block->used;
+    if (p_arena->used > p_arena->peak)
+        p_arena->peak = p_arena->used;
+    block->used = offset + p_size;
+    return block->data + offset;
+}
+
+
+void *arenaAlloc(Arena *p_arena, size_t p_size) {
+    return arenaAllocAligned(p_arena, p_size, sizeof(void*));
+}
+
+
+char *arenaStrndup(Arena *p_arena, const char *p_str, size_t p_len) {
+    char *str = (char*)arenaAllocAligned(p_arena, p_len + 1, 1);
+    if (!str)
+        return NULL;
+    memcpy(str, p_str, p_len);
+    str[p_len] = '\0';
+    return str;
+}
+
+
+void arenaReset(Arena *p_arena) {
+    Block *block = p_arena->current;
+    while (block->prev) {
+        Block *prev = block->prev;
+        free(block);
+        block = prev;
+    }
+    block->used = 0;
+    p_arena->current = block;
+    p_arena->used = 0;
+}
+
+
+/*
+ * Hands every block of p_other over to p_arena, which keeps allocating from
+ * its own current block. p_other is freed.
+*/
+void arenaAdopt(Arena *p_arena, Arena *p_other) {
+    Block *oldest = p_other->current;
+    while (oldest->prev)
+        oldest = oldest->prev;
+    oldest->prev = p_arena->current->prev;
+    p_arena->current->prev = p_other->current;
+    p_arena->used += p_other->used;
+    if (p_arena->used > p_arena->peak)
+        p_arena->peak = p_arena->used;
+    free(p_other);
+}
+
+
+size_t arenaGetUsed(const Arena *p_arena) {
+    return p_arena->used;
+}
+
+
+size_t arenaGetPeak(const Arena *p_arena) {
+    return p_arena->peak;
+}
+
+
+void arenaTerminate(Arena *p_arena) {
+    for (Block *block = p_arena->current, *prev; block; block = prev) {
+        prev = block->prev;
+        free(block);
+    }
+    free(p_arena);
+}
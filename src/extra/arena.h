@@ -0,0 +1,18 @@
+#ifndef ARENA_H
+#define ARENA_H
+#include <stddef.h>
+
+
+typedef struct Arena Arena;
+
+
+Arena *arenaInit(size_t p_block_size);
+void *arenaAlloc(Arena *p_arena, size_t p_size);
+void *arenaAllocAligned(Arena *p_arena, size_t p_size, size_t p_align);
+char *arenaStrndup(Arena *p_arena, const char *p_str, size_t p_len);
+void arenaReset(Arena *p_arena);
+void arenaAdopt(Arena *p_arena, Arena *p_other);
+size_t arenaGetUsed(const Arena *p_arena);
+size_t arenaGetPeak(const Arena *p_arena);
+void arenaTerminate(Arena *p_arena);
+#endif // ARENA_H
@@ -1,5 +1,6 @@
 #include "hash.h"
 #include <stdint.h>
+#include <string.h>
 
 
 uint32_t hashFNV1AStr(const char *p_str) {
@@ -11,21 +12,25 @@ uint32_t hashFNV1AStr(const char *p_str) {
     return hash;
 }
 
-uint64_t hashBase53(uint32_t p_val) {
-    uint64_t _id = 0;
-    uint8_t *id = (uint8_t*)&_id;
-    const char base53[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz_";
-    id[5] = base53[p_val / 418195493];
-    p_val %= 418195493;
-    id[4] = base53[p_val / 7890481];
-    p_val %= 7890481;
-    id[3] = base53[p_val / 148877];
-    p_val %= 148877;
-    id[2] = base53[p_val / 2809];
-    p_val %= 2809;
-    id[1] = base53[p_val / 53];
-    p_val %= 53;
-    id[0] = base53[p_val];
-    return *(uint64_t*)id;
+static inline uint64_t _mix(uint64_t p_a, uint64_t p_b) {
+    __uint128_t r = (__uint128_t)p_a * p_b;
+    return (uint64_t)r ^ (uint64_t)(r >> 64);
 }
 
+// Word at a time hash, short keys such as identifiers as much as whole files
+uint64_t hashWords64(const char *p_str, size_t p_len) {
+    uint64_t hash = 0x9E3779B97F4A7C15ull ^ p_len;
+    for (; p_len >= 8; p_str += 8, p_len -= 8) {
+        uint64_t word;
+        memcpy(&word, p_str, 8);
+        hash = _mix(hash ^ word, 0xA0761D6478BD642Full);
+    }
+    uint64_t tail = 0;
+    memcpy(&tail, p_str, p_len);
+    return _mix(hash ^ tail, 0xE7037ED1A0B428DBull);
+}
+
+uint32_t hashWords(const char *p_str, size_t p_len) {
+    uint64_t hash = hashWords64(p_str, p_len);
+    return (uint32_t)(hash ^ (hash >> 32));
+}
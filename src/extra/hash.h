@@ -1,8 +1,10 @@
 #ifndef HASH_H
 #define HASH_H
 #include <stdint.h>
+#include <stddef.h>
 
 
 uint32_t hashFNV1AStr(const char *p_str);
-uint64_t hashBase53(uint32_t p_val);
+uint32_t hashWords(const char *p_str, size_t p_len);
+uint64_t hashWords64(const char *p_str, size_t p_len);
 #endif // HASH_H
@@ -0,0 +1,239 @@
+#include "interner.h"
+#include "arena.h"
+#include "hash.h"
+
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include <stdatomic.h>
+#include <pthread.h>
+
+/*
+ * The table is split in shards picked by the top bits of the hash, each with
+ * its own lock, so threads interning different names rarely meet. Symbols live
+ * in fixed size pages that never move, reading a symbol by id takes no lock.
+ * A small per-thread cache in front of the shards answers most repeated
+ * lookups without touching any shared cache line.
+*/
+
+#define SHARD_BITS 6
+#define SHARD_COUNT (1 << SHARD_BITS)
+#define SHARD_INITIAL_CAPACITY 64
+#define PAGE_BITS 12
+#define PAGE_SIZE (1 << PAGE_BITS)
+#define MAX_PAGES (1 << 16)
+#define CACHE_SIZE 1024
+#define EMPTY_SLOT 0
+
+
+typedef struct {
+    uint32_t hash;
+    uint32_t id_plus_one;
+} Slot;
+
+
+typedef struct {
+    const char *str;
+    uint32_t len;
+} Symbol;
+
+
+typedef struct {
+    pthread_mutex_t lock;
+    Arena *strings;
+    Slot *slots;
+    uint32_t mask;
+    uint32_t count;
+} Shard;
+
+
+struct Interner {
+    uint64_t serial;
+    atomic_uint count;
+    Shard shards[SHARD_COUNT];
+    _Atomic(Symbol*) pages[MAX_PAGES];
+};
+
+
+typedef struct {
+    uint64_t serial;
+    uint32_t hash;
+    uint32_t id;
+    uint32_t len;
+    const char *str;
+} CacheEntry;
+
+
+static atomic_uint_fast64_t next_serial = 1;
+static _Thread_local CacheEntry cache[CACHE_SIZE];
+
+
+Interner *internerInit(void) {
+    Interner *interner = (Interner*)calloc(1, sizeof(Interner));
+    if (!interner)
+        return NULL;
+    interner->serial = atomic_fetch_add(&next_serial, 1);
+    atomic_init(&interner->count, 0);
+    for (int i = 0; i < SHARD_COUNT; i++) {
+        Shard *shard = &interner->shards[i];
+        pthread_mutex_init(&shard->lock, NULL);
+        shard->strings = arenaInit(16 * 1024);
+        shard->slots = (Slot*)calloc(SHARD_INITIAL_CAPACITY, sizeof(Slot));
+        shard->mask = SHARD_INITIAL_CAPACITY - 1;
+        if (!shard->strings || !shard->slots) {
+            internerTerminate(interner);
+            return NULL;
+        }
+    }
+    return interner;
+}
+
+
+static Interner *global = NULL;
+static pthread_once_t global_once = PTHREAD_ONCE_INIT;
+
+static void _init_global(void) {
+    global = internerInit();
+}
+
+Interner *internerGlobal(void) {
+    pthread_once(&global_once, _init_global);
+    return global;
+}
+
+
+static bool _grow(Shard *p_shard) {
+    uint32_t size = (p_shard->mask + 1) * 2;
+    Slot *slots = (Slot*)calloc(size, sizeof(Slot));
+    if (!slots)
+        return false;
+    for (uint32_t i = 0; i <= p_shard->mask; i++) {
+        Slot slot = p_shard->slots[i];
+        if (slot.id_plus_one == EMPTY_SLOT)
+            continue;
+        uint32_t at = slot.hash & (size - 1);
+        while (slots[at].id_plus_one != EMPTY_SLOT)
+            at = (at + 1) & (size - 1);
+        slots[at] = slot;
+    }
+    free(p_shard->slots);
+    p_shard->slots = slots;
+    p_shard->mask = size - 1;
+    return true;
+}
+
+
+static Symbol *_symbol(const Interner *p_interner, uint32_t p_id) {
+    Symbol *page = atomic_load_explicit(&((Interner*)p_interner)->pages[p_id >> PAGE_BITS], memory_order_acquire);
+    return &page[p_id & (PAGE_SIZE - 1)];
+}
+
+
+static bool _publish(Interner *p_interner, uint32_t p_id, Symbol p_symbol) {
+    _Atomic(Symbol*) *slot = &p_interner->pages[p_id >> PAGE_BITS];
+    Symbol *page = atomic_load_explicit(slot, memory_order_acquire);
+    if (!page) {
+        Symbol *fresh = (Symbol*)calloc(PAGE_SIZE, sizeof(Symbol));
+        if (!fresh)
+            return false;
+        if (atomic_compare_exchange_strong(slot, &page, fresh))
+            page = fresh;
+        else
+            free(fresh);
+    }
+    page[p_id & (PAGE_SIZE - 1)] = p_symbol;
+    return true;
+}
+
+
+static uint32_t _intern_locked(Interner *p_interner, Shard *p_shard, uint32_t p_hash, const char *p_str, size_t p_len) {
+    uint32_t at = p_hash & p_shard->mask;
+    for (;; at = (at + 1) & p_shard->mask) {
+        Slot slot = p_shard->slots[at];
+        if (slot.id_plus_one == EMPTY_SLOT)
+            break;
+        if (slot.hash != p_hash)
+            continue;
+        const Symbol *sym = _symbol(p_interner, slot.id_plus_one - 1);
+        if (sym->len == p_len && !memcmp(sym->str, p_str, p_len))
+            return slot.id_plus_one - 1;
+    }
+
+    // Keep every shard at most half full
+    if ((p_shard->count + 1) * 2 > p_shard->mask + 1) {
+        if (!_grow(p_shard))
+            return UINT32_MAX;
+        at = p_hash & p_shard->mask;
+        while (p_shard->slots[at].id_plus_one != EMPTY_SLOT)
+            at = (at + 1) & p_shard->mask;
+    }
+
+    uint32_t id = atomic_fetch_add_explicit(&p_interner->count, 1, memory_order_relaxed);
+    if (id >= (uint32_t)MAX_PAGES * PAGE_SIZE)
+        return UINT32_MAX;
+    Symbol sym = {
+        .str = arenaStrndup(p_shard->strings, p_str, p_len),
+        .len = p_len
+    };
+    if (!sym.str || !_publish(p_interner, id, sym))
+        return UINT32_MAX;
+    p_shard->slots[at] = (Slot){.hash = p_hash, .id_plus_one = id + 1};
+    p_shard->count++;
+    return id;
+}
+
+
+uint32_t internerIntern(Interner *p_interner, const char *p_str, size_t p_len) {
+    uint32_t hash = hashWords(p_str, p_len);
+    CacheEntry *entry = &cache[hash & (CACHE_SIZE - 1)];
+    if (entry->serial == p_interner->serial && entry->hash == hash &&
+        entry->len == p_len && !memcmp(entry->str, p_str, p_len))
+        return entry->id;
+
+    Shard *shard = &p_interner->shards[hash >> (32 - SHARD_BITS)];
+    pthread_mutex_lock(&shard->lock);
+    uint32_t id = _intern_locked(p_interner, shard, hash, p_str, p_len);
+    pthread_mutex_unlock(&shard->lock);
+
+    if (id != UINT32_MAX)
+        *entry = (CacheEntry){
+            .serial = p_interner->serial,
+            .hash = hash,
+            .id = id,
+            .len = p_len,
+            .str = _symbol(p_interner, id)->str
+        };
+    return id;
+}
+
+
+const char *internerGetString(const Interner *p_interner, uint32_t p_id) {
+    assert(p_id < internerGetCount(p_interner));
+    return _symbol(p_interner, p_id)->str;
+}
+
+
+uint32_t internerGetLength(const Interner *p_interner, uint32_t p_id) {
+    assert(p_id < internerGetCount(p_interner));
+    return _symbol(p_interner, p_id)->len;
+}
+
+
+uint32_t internerGetCount(const Interner *p_interner) {
+    return atomic_load(&((Interner*)p_interner)->count);
+}
+
+
+void internerTerminate(Interner *p_interner) {
+    for (int i = 0; i < SHARD_COUNT; i++) {
+        Shard *shard = &p_interner->shards[i];
+        if (shard->strings)
+            arenaTerminate(shard->strings);
+        free(shard->slots);
+        pthread_mutex_destroy(&shard->lock);
+    }
+    for (uint32_t i = 0; i < MAX_PAGES; i++)
+        free(atomic_load(&p_interner->pages[i]));
+    free(p_interner);
+}
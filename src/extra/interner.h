@@ -0,0 +1,22 @@
+#ifndef INTERNER_H
+#define INTERNER_H
+#include <stdint.h>
+#include <stddef.h>
+
+
+/*
+ * Maps every distinct string to a dense symbol id (0, 1, 2...), ids are stable
+ * for the lifetime of the interner and can index flat arrays. Safe to share
+ * between threads, every thread sees the same id for the same string.
+*/
+typedef struct Interner Interner;
+
+
+Interner *internerInit(void);
+Interner *internerGlobal(void);
+uint32_t internerIntern(Interner *p_interner, const char *p_str, size_t p_len);
+const char *internerGetString(const Interner *p_interner, uint32_t p_id);
+uint32_t internerGetLength(const Interner *p_interner, uint32_t p_id);
+uint32_t internerGetCount(const Interner *p_interner);
+void internerTerminate(Interner *p_interner);
+#endif // INTERNER_H
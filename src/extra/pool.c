@@ -0,0 +1,197 @@
+#include "pool.h"
+#include "trace.h"
+
+#include <stdbool.h>
+#include <stdlib.h>
+#include <stdatomic.h>
+#include <pthread.h>
+
+/*
+ * Chase-Lev deques, filled before any thread starts and never pushed to
+ * afterwards: the owner pops at the bottom, thieves take from the top and
+ * only the last task is ever fought over. Tasks are dealt round robin and
+ * laid out so the owner goes through its share in increasing order while
+ * thieves take what is furthest away, early tasks finish first.
+*/
+
+typedef enum {
+    STEAL_EMPTY,
+    STEAL_LOST,
+    STEAL_TAKEN,
+} StealResult;
+
+
+typedef struct {
+    _Alignas(64) atomic_long top;
+    _Alignas(64) atomic_long bottom;
+    size_t *tasks;
+    struct Pool *pool;
+    pthread_t thread;
+    bool started;
+} Deque;
+
+
+struct Pool {
+    PoolRun run;
+    void *ctx;
+    int threads;
+    Deque *deques;
+    size_t *tasks;
+    atomic_size_t steals;
+    bool joined;
+};
+
+
+static bool _pop(Deque *p_deque, size_t *p_task) {
+    // Sequentially consistent so the owner and a thief cannot both miss the other
+    long bottom = atomic_load_explicit(&p_deque->bottom, memory_order_relaxed) - 1;
+    atomic_store(&p_deque->bottom, bottom);
+    long top = atomic_load(&p_deque->top);
+    if (top > bottom) {
+        atomic_store_explicit(&p_deque->bottom, bottom + 1, memory_order_relaxed);
+        return false;
+    }
+    *p_task = p_deque->tasks[bottom];
+    if (top < bottom)
+        return true;
+    // The last one, a thief may be after it too
+    bool won = atomic_compare_exchange_strong_explicit(&p_deque->top, &top, top + 1,
+        memory_order_seq_cst, memory_order_relaxed);
+    atomic_store_explicit(&p_deque->bottom, bottom + 1, memory_order_relaxed);
+    return won;
+}
+
+
+static StealResult _steal(Deque *p_deque, size_t *p_task) {
+    long top = atomic_load(&p_deque->top);
+    long bottom = atomic_load(&p_deque->bottom);
+    if (top >= bottom)
+        return STEAL_EMPTY;
+    *p_task = p_deque->tasks[top];
+    if (!atomic_compare_exchange_strong_explicit(&p_deque->top, &top, top + 1,
+            memory_order_seq_cst, memory_order_relaxed))
+        return STEAL_LOST;
+    return STEAL_TAKEN;
+}
+
+
+/*
+ * Nothing is ever added, so a thread is done once a whole round over the
+ * other deques finds them all empty.
+*/
+static void *_work(void *p_deque) {
+    Deque *own = (Deque*)p_deque;
+    Pool *pool = own->pool;
+    int index = (int)(own - pool->deques);
+    traceNameThread("Pool worker");
+    size_t task;
+    while (true) {
+        while (_pop(own, &task))
+            pool->run(pool->ctx, task, index);
+        StealResult result = STEAL_EMPTY;
+        bool contended;
+        do {
+            contended = false;
+            for (int i = 1; i < pool->threads; i++) {
+                result = _steal(&pool->deques[(index + i) % pool->threads], &task);
+                if (result == STEAL_TAKEN)
+                    break;
+                contended |= result == STEAL_LOST;
+            }
+        } while (result != STEAL_TAKEN && contended);
+        if (result != STEAL_TAKEN)
+            return NULL;
+        atomic_fetch_add_explicit(&pool->steals, 1, memory_order_relaxed);
+        pool->run(pool->ctx, task, index);
+    }
+}
+
+
+/*
+ * Starts the threads right away, poolWait waits for every task. Fails
+ * unless at least one thread started: those that did steal the tasks of
+ * those that did not, so every task runs before poolWait is even called.
+*/
+Pool *poolInit(int p_threads, size_t p_count, PoolRun p_run, void *p_ctx) {
+    if (p_threads < 1)
+        p_threads = 1;
+    if ((size_t)p_threads > p_count)
+        p_threads = p_count ? (int)p_count : 1;
+    Pool *pool = (Pool*)malloc(sizeof(Pool));
+    if (!pool)
+        return NULL;
+    pool->run = p_run;
+    pool->ctx = p_ctx;
+    pool->threads = p_threads;
+    pool->deques = (Deque*)aligned_alloc(_Alignof(Deque), p_threads * sizeof(Deque));
+    pool->tasks = (size_t*)malloc((p_count ? p_count : 1) * sizeof(size_t));
+    atomic_init(&pool->steals, 0);
+    pool->joined = false;
+    if (!pool->deques || !pool->tasks) {
+        free(pool->deques);
+        free(pool->tasks);
+        free(pool);
+        return NULL;
+    }
+
+    // Thread i gets tasks i, i + threads... stored backwards behind its share of the array
+    size_t *tasks = pool->tasks;
+    for (int i = 0; i < p_threads; i++) {
+        Deque *deque = &pool->deques[i];
+        size_t share = p_count / p_threads + ((size_t)i < p_count % p_threads);
+        for (size_t j = 0; j < share; j++)
+            tasks[share - 1 - j] = i + j * p_threads;
+        deque->tasks = tasks;
+        atomic_init(&deque->top, 0);
+        atomic_init(&deque->bottom, (long)share);
+        deque->pool = pool;
+        deque->started = false;
+        tasks += share;
+    }
+    bool any = false;
+    for (int i = 0; i < p_threads; i++)
+        any |= pool->deques[i].started = !pthread_create(&pool->deques[i].thread, NULL, _work, &pool->deques[i]);
+    if (!any) {
+        free(pool->deques);
+        free(pool->tasks);
+        free(pool);
+        return NULL;
+    }
+    return pool;
+}
+
+
+int poolGetThreads(const Pool *p_pool) {
+    return p_pool->threads;
+}
+
+
+/*
+ * How many tasks ran on another thread than the one they were dealt to, all
+ * of them once poolWait returned.
+*/
+size_t poolGetSteals(const Pool *p_pool) {
+    return atomic_load_explicit(&p_pool->steals, memory_order_relaxed);
+}
+
+
+void poolWait(Pool *p_pool) {
+    if (p_pool->joined)
+        return;
+    p_pool->joined = true;
+    for (int i = 0; i < p_pool->threads; i++)
+        if (p_pool->deques[i].started)
+            pthread_join(p_pool->deques[i].thread, NULL);
+    // The deque of a thread that could not be started is stolen from by the others, anything left runs here
+    for (int i = 0; i < p_pool->threads; i++)
+        if (!p_pool->deques[i].started)
+            _work(&p_pool->deques[i]);
+}
+
+
+void poolTerminate(Pool *p_pool) {
+    poolWait(p_pool);
+    free(p_pool->deques);
+    free(p_pool->tasks);
+    free(p_pool);
+}
@@ -0,0 +1,22 @@
+#ifndef POOL_H
+#define POOL_H
+#include <stddef.h>
+
+
+/*
+ * Runs tasks 0 to count - 1 on a fixed set of threads. Every thread starts
+ * with its own deque of tasks and takes them in order from one end, a thread
+ * that runs out steals from the other end of someone else's. p_run gets the
+ * task and the index of the thread running it, which can pick per-thread
+ * state: no two tasks run on the same thread index at once.
+*/
+typedef struct Pool Pool;
+typedef void (*PoolRun)(void *p_ctx, size_t p_task, int p_thread);
+
+
+Pool *poolInit(int p_threads, size_t p_count, PoolRun p_run, void *p_ctx);
+int poolGetThreads(const Pool *p_pool);
+size_t poolGetSteals(const Pool *p_pool);
+void poolWait(Pool *p_pool);
+void poolTerminate(Pool *p_pool);
+#endif // POOL_H
@@ -0,0 +1,151 @@
+#define _POSIX_C_SOURCE 200809L
+#include "sink.h"
+
+#include <errno.h>
+#include <stdarg.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#define DEFAULT_BUFFER_SIZE (1024 * 1024)
+// Enough for any integer and most floats, longer formats go through a heap copy
+#define FORMAT_SIZE 64
+
+
+struct Sink {
+    int fd;
+    bool failed;
+    size_t used;
+    size_t size;
+    char buffer[];
+};
+
+
+Sink *sinkInit(int p_fd, size_t p_buffer_size) {
+    size_t size = p_buffer_size ? p_buffer_size : DEFAULT_BUFFER_SIZE;
+    Sink *sink = (Sink*)malloc(sizeof(Sink) + size);
+    if (!sink)
+        return NULL;
+    sink->fd = p_fd;
+    sink->failed = false;
+    sink->used = 0;
+    sink->size = size;
+    return sink;
+}
+
+
+static void _write_out(Sink *p_sink, const char *p_data, size_t p_size) {
+    while (p_size && !p_sink->failed) {
+        ssize_t n = write(p_sink->fd, p_data, p_size);
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n <= 0) {
+            p_sink->failed = true;
+            return;
+        }
+        p_data += n;
+        p_size -= n;
+    }
+}
+
+
+int sinkFlush(Sink *p_sink) {
+    _write_out(p_sink, p_sink->buffer, p_sink->used);
+    p_sink->used = 0;
+    return p_sink->failed ? -1 : 0;
+}
+
+
+void sinkWrite(Sink *p_sink, const char *p_data, size_t p_size) {
+    if (p_sink->used + p_size > p_sink->size) {
+        sinkFlush(p_sink);
+        // Too big to be worth a copy
+        if (p_size > p_sink->size / 2) {
+            _write_out(p_sink, p_data, p_size);
+            return;
+        }
+    }
+    memcpy(p_sink->buffer + p_sink->used, p_data, p_size);
+    p_sink->used += p_size;
+}
+
+
+void sinkPutc(Sink *p_sink, char p_c) {
+    if (p_sink->used == p_sink->size)
+        sinkFlush(p_sink);
+    p_sink->buffer[p_sink->used++] = p_c;
+}
+
+
+void sinkPuts(Sink *p_sink, const char *p_str) {
+    sinkWrite(p_sink, p_str, strlen(p_str));
+}
+
+
+void sinkRepeat(Sink *p_sink, char p_c, size_t p_count) {
+    while (p_count) {
+        if (p_sink->used == p_sink->size)
+            sinkFlush(p_sink);
+        size_t n = p_sink->size - p_sink->used;
+        n = n < p_count ? n : p_count;
+        memset(p_sink->buffer + p_sink->used, p_c, n);
+        p_sink->used += n;
+        p_count -= n;
+    }
+}
+
+
+void sinkUInt(Sink *p_sink, uint64_t p_val) {
+    char digits[20];
+    char *c = digits + sizeof(digits);
+    do {
+        *--c = '0' + p_val % 10;
+        p_val /= 10;
+    } while (p_val);
+    sinkWrite(p_sink, c, digits + sizeof(digits) - c);
+}
+
+
+void sinkInt(Sink *p_sink, int64_t p_val) {
+    if (p_val < 0) {
+        sinkPutc(p_sink, '-');
+        // Negated as unsigned so INT64_MIN survives
+        sinkUInt(p_sink, -(uint64_t)p_val);
+        return;
+    }
+    sinkUInt(p_sink, (uint64_t)p_val);
+}
+
+
+void sinkPrintf(Sink *p_sink, const char *p_format, ...) {
+    char text[FORMAT_SIZE];
+    va_list args;
+    va_start(args, p_format);
+    int length = vsnprintf(text, sizeof(text), p_format, args);
+    va_end(args);
+    if (length < 0)
+        return;
+    if ((size_t)length < sizeof(text)) {
+        sinkWrite(p_sink, text, length);
+        return;
+    }
+    char *long_text = (char*)malloc(length + 1);
+    if (!long_text) {
+        p_sink->failed = true;
+        return;
+    }
+    va_start(args, p_format);
+    vsnprintf(long_text, length + 1, p_format, args);
+    va_end(args);
+    sinkWrite(p_sink, long_text, length);
+    free(long_text);
+}
+
+
+int sinkTerminate(Sink *p_sink) {
+    int status = sinkFlush(p_sink);
+    free(p_sink);
+    return status;
+}
@@ -0,0 +1,26 @@
+#ifndef SINK_H
+#define SINK_H
+#include <stddef.h>
+#include <stdint.h>
+
+
+/*
+ * Buffered writer over a file descriptor, the buffer only goes to the kernel
+ * when full or flushed. Nothing is shared between sinks, each thread can
+ * write its own. A failed write sticks: later writes are dropped and the
+ * error comes back from sinkFlush and sinkTerminate.
+*/
+typedef struct Sink Sink;
+
+
+Sink *sinkInit(int p_fd, size_t p_buffer_size);
+void sinkWrite(Sink *p_sink, const char *p_data, size_t p_size);
+void sinkPutc(Sink *p_sink, char p_c);
+void sinkPuts(Sink *p_sink, const char *p_str);
+void sinkRepeat(Sink *p_sink, char p_c, size_t p_count);
+void sinkInt(Sink *p_sink, int64_t p_val);
+void sinkUInt(Sink *p_sink, uint64_t p_val);
+void sinkPrintf(Sink *p_sink, const char *p_format, ...) __attribute__((format(printf, 2, 3)));
+int sinkFlush(Sink *p_sink);
+int sinkTerminate(Sink *p_sink);
+#endif // SINK_H
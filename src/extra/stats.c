@@ -0,0 +1,123 @@
+#define _POSIX_C_SOURCE 200809L
+#include "stats.h"
+
+#include <pthread.h>
+#include <stdlib.h>
+#include <sys/resource.h>
+
+
+typedef struct Block {
+    struct Block *next;
+    uint64_t counters[STAT_COUNT];
+} Block;
+
+
+typedef struct {
+    const char *name;
+    const char *label;
+    // Merged by taking the largest rather than by adding up
+    bool max;
+} CounterInfo;
+
+
+static const CounterInfo counters[STAT_COUNT] = {
+    [STAT_BYTES_READ] = {"bytes_read", "bytes read", false},
+    [STAT_TOKENS] = {"tokens", "tokens lexed", false},
+    [STAT_TOKEN_BYTES] = {"token_bytes", "token bytes", false},
+    [STAT_LITERALS] = {"literals", "literals", false},
+    [STAT_LITERAL_BYTES] = {"literal_bytes", "literal bytes", false},
+    [STAT_FRAMES] = {"frames", "parse frames", false},
+    [STAT_FRAME_BYTES] = {"frame_bytes", "parse frame bytes", false},
+    [STAT_MAX_DEPTH] = {"max_depth", "max parse depth", true},
+    [STAT_NODES] = {"nodes", "nodes built", false},
+    [STAT_NODE_BYTES] = {"node_bytes", "node bytes", false},
+    [STAT_LISTS] = {"lists", "list links", false},
+    [STAT_LIST_BYTES] = {"list_bytes", "list link bytes", false},
+};
+
+
+bool statsOn = false;
+
+static pthread_mutex_t mutex = PTHREAD_MUTEX_INITIALIZER;
+static Block *blocks = NULL;
+static _Thread_local Block *local = NULL;
+
+
+/*
+ * The calling thread's counters, made and listed on first use. Kept after
+ * the thread is gone, until the process is.
+*/
+static Block *_block(void) {
+    if (local)
+        return local;
+    Block *block = (Block*)calloc(1, sizeof(Block));
+    if (!block)
+        abort();
+    pthread_mutex_lock(&mutex);
+    block->next = blocks;
+    blocks = block;
+    pthread_mutex_unlock(&mutex);
+    return local = block;
+}
+
+
+/*
+ * Call before any thread that counts is started.
+*/
+void statsStart(void) {
+    statsOn = true;
+}
+
+
+void statsAdd(StatCounter p_counter, uint64_t p_count) {
+    _block()->counters[p_counter] += p_count;
+}
+
+
+void statsMax(StatCounter p_counter, uint64_t p_value) {
+    Block *block = _block();
+    if (p_value > block->counters[p_counter])
+        block->counters[p_counter] = p_value;
+}
+
+
+/*
+ * Merged over every thread, only once the threads that counted are done.
+*/
+uint64_t statsGet(StatCounter p_counter) {
+    uint64_t value = 0;
+    pthread_mutex_lock(&mutex);
+    for (Block *block = blocks; block; block = block->next) {
+        uint64_t count = block->counters[p_counter];
+        if (!counters[p_counter].max)
+            value += count;
+        else if (count > value)
+            value = count;
+    }
+    pthread_mutex_unlock(&mutex);
+    return value;
+}
+
+
+/*
+ * Every counter and the peak resident size of the process, one per line or
+ * as a JSON object.
+*/
+void statsPrint(FILE *p_file, bool p_json) {
+    struct rusage usage;
+    // ru_maxrss is in kilobytes on Linux
+    uint64_t peak = getrusage(RUSAGE_SELF, &usage) ? 0 : (uint64_t)usage.ru_maxrss * 1024;
+    if (p_json)
+        fputc('{', p_file);
+    for (int i = 0; i < STAT_COUNT; i++) {
+        unsigned long long value = statsGet((StatCounter)i);
+        if (p_json)
+            fprintf(p_file, "\"%s\":%llu,", counters[i].name, value);
+        else
+            fprintf(p_file, "%-20s %llu\n", counters[i].label, value);
+    }
+    if (p_json)
+        fprintf(p_file, "\"peak_rss_bytes\":%llu}\n", (unsigned long long)peak);
+    else
+        fprintf(p_file, "%-20s %llu\n", "peak rss bytes", (unsigned long long)peak);
+}
@@ -0,0 +1,42 @@
+#ifndef STATS_H
+#define STATS_H
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+
+
+/*
+ * Counters of what the frontend allocated and went through. Each thread
+ * counts into a block of its own, the blocks are merged when printed.
+ * Until statsStart the macros below only test a flag.
+*/
+typedef enum {
+    STAT_BYTES_READ,
+    STAT_TOKENS,
+    STAT_TOKEN_BYTES,
+    STAT_LITERALS,
+    STAT_LITERAL_BYTES,
+    STAT_FRAMES,
+    STAT_FRAME_BYTES,
+    STAT_MAX_DEPTH,
+    STAT_NODES,
+    STAT_NODE_BYTES,
+    STAT_LISTS,
+    STAT_LIST_BYTES,
+    STAT_COUNT
+} StatCounter;
+
+
+extern bool statsOn;
+
+// Expressions, so they fit in a comma list
+#define STATS_ADD(COUNTER, N) (statsOn ? statsAdd(COUNTER, N) : (void)0)
+#define STATS_MAX(COUNTER, N) (statsOn ? statsMax(COUNTER, N) : (void)0)
+
+
+void statsStart(void);
+void statsAdd(StatCounter p_counter, uint64_t p_count);
+void statsMax(StatCounter p_counter, uint64_t p_value);
+uint64_t statsGet(StatCounter p_counter);
+void statsPrint(FILE *p_file, bool p_json);
+#endif // STATS_H
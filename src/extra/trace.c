@@ -0,0 +1,255 @@
+#define _POSIX_C_SOURCE 200809L
+#include "trace.h"
+#include "arena.h"
+#include "sink.h"
+
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#define MAX_TOTALS 64
+#define TOTAL_NAME_SIZE 128
+#define STRINGS_BLOCK_SIZE (64 * 1024)
+
+
+typedef struct {
+    const char *name;
+    const char *detail;
+    uint64_t start;
+    uint64_t duration;
+} Event;
+
+
+typedef struct Buffer {
+    struct Buffer *next;
+    int tid;
+    const char *name;
+    Event *events;
+    size_t count;
+    size_t capacity;
+    // Copies of the details, which the caller may free right after
+    Arena *strings;
+} Buffer;
+
+
+typedef struct {
+    const char *name;
+    uint64_t nanoseconds;
+    uint64_t count;
+} Total;
+
+
+bool traceOn = false;
+
+static uint64_t origin;
+static pthread_mutex_t mutex = PTHREAD_MUTEX_INITIALIZER;
+static Buffer *buffers = NULL;
+static int thread_count = 0;
+static Total totals[MAX_TOTALS];
+static int total_count = 0;
+static _Thread_local Buffer *local = NULL;
+
+
+static uint64_t _clock(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+
+/*
+ * The calling thread's buffer, made and listed on its first event.
+*/
+static Buffer *_buffer(void) {
+    if (local)
+        return local;
+    Buffer *buffer = (Buffer*)calloc(1, sizeof(Buffer));
+    if (!buffer || !(buffer->strings = arenaInit(STRINGS_BLOCK_SIZE)))
+        abort();
+    pthread_mutex_lock(&mutex);
+    buffer->tid = ++thread_count;
+    buffer->next = buffers;
+    buffers = buffer;
+    pthread_mutex_unlock(&mutex);
+    return local = buffer;
+}
+
+
+static void _escaped(Sink *p_sink, const char *p_str) {
+    sinkPutc(p_sink, '"');
+    for (const unsigned char *c = (const unsigned char*)p_str; *c; c++) {
+        if (*c == '"' || *c == '\\') {
+            sinkPutc(p_sink, '\\');
+            sinkPutc(p_sink, *c);
+        } else if (*c < 0x20) {
+            sinkPrintf(p_sink, "\\u%04x", *c);
+        } else {
+            sinkPutc(p_sink, *c);
+        }
+    }
+    sinkPutc(p_sink, '"');
+}
+
+
+/*
+ * Starts a record of the array, only those after the first follow a comma.
+*/
+static void _record(Sink *p_sink, bool *p_first) {
+    sinkPuts(p_sink, *p_first ? "\n" : ",\n");
+    *p_first = false;
+}
+
+
+static void _thread_name(Sink *p_sink, int p_tid, const char *p_name, bool *p_first) {
+    _record(p_sink, p_first);
+    sinkPrintf(p_sink, "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%d,\"args\":{\"name\":", p_tid);
+    _escaped(p_sink, p_name);
+    sinkPuts(p_sink, "}}");
+}
+
+
+static void _event(Sink *p_sink, const char *p_name, int p_tid, uint64_t p_start, uint64_t p_duration, bool *p_first) {
+    _record(p_sink, p_first);
+    sinkPuts(p_sink, "{\"name\":");
+    _escaped(p_sink, p_name);
+    sinkPrintf(p_sink, ",\"ph\":\"X\",\"pid\":1,\"tid\":%d,\"ts\":%.3f,\"dur\":%.3f",
+        p_tid, p_start / 1e3, p_duration / 1e3);
+}
+
+
+/*
+ * Times are from here on, call before any thread that records is started.
+*/
+void traceStart(void) {
+    origin = _clock();
+    traceOn = true;
+}
+
+
+/*
+ * Nanoseconds since traceStart.
+*/
+uint64_t traceNow(void) {
+    return _clock() - origin;
+}
+
+
+uint64_t traceBegin(void) {
+    return traceOn ? traceNow() : 0;
+}
+
+
+/*
+ * Records the scope opened by the traceBegin that returned p_start.
+ * p_name has to live until traceWrite, p_detail is copied and may be NULL.
+*/
+void traceEnd(const char *p_name, const char *p_detail, uint64_t p_start) {
+    if (!traceOn)
+        return;
+    uint64_t end = traceNow();
+    Buffer *buffer = _buffer();
+    if (buffer->count == buffer->capacity) {
+        size_t capacity = buffer->capacity ? buffer->capacity * 2 : 256;
+        Event *grown = (Event*)realloc(buffer->events, capacity * sizeof(Event));
+        if (!grown)
+            abort();
+        buffer->events = grown;
+        buffer->capacity = capacity;
+    }
+    Event *event = &buffer->events[buffer->count++];
+    event->name = p_name;
+    event->detail = p_detail ? arenaStrndup(buffer->strings, p_detail, strlen(p_detail)) : NULL;
+    event->start = p_start;
+    event->duration = end - p_start;
+}
+
+
+/*
+ * Adds to the total of p_name, p_count being how many times it ran.
+*/
+void traceTotal(const char *p_name, uint64_t p_nanoseconds, uint64_t p_count) {
+    if (!traceOn || !p_count)
+        return;
+    pthread_mutex_lock(&mutex);
+    int i = 0;
+    while (i < total_count && strcmp(totals[i].name, p_name))
+        i++;
+    if (i == total_count && total_count < MAX_TOTALS)
+        totals[total_count++] = (Total){p_name, 0, 0};
+    if (i < total_count) {
+        totals[i].nanoseconds += p_nanoseconds;
+        totals[i].count += p_count;
+    }
+    pthread_mutex_unlock(&mutex);
+}
+
+
+/*
+ * How the calling thread shows in the viewer, p_name has to live until traceWrite.
+*/
+void traceNameThread(const char *p_name) {
+    if (traceOn)
+        _buffer()->name = p_name;
+}
+
+
+/*
+ * Writes out everything recorded and drops it. Every other thread that
+ * recorded has to be done by then.
+*/
+int traceWrite(const char *p_path) {
+    int fd = open(p_path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0)
+        return -1;
+    Sink *sink = sinkInit(fd, 0);
+    if (!sink) {
+        close(fd);
+        return -1;
+    }
+    pthread_mutex_lock(&mutex);
+    bool first = true;
+    sinkPuts(sink, "{\"traceEvents\":[");
+    for (Buffer *buffer = buffers; buffer; buffer = buffer->next) {
+        for (size_t i = 0; i < buffer->count; i++) {
+            const Event *event = &buffer->events[i];
+            _event(sink, event->name, buffer->tid, event->start, event->duration, &first);
+            if (event->detail) {
+                sinkPuts(sink, ",\"args\":{\"detail\":");
+                _escaped(sink, event->detail);
+                sinkPutc(sink, '}');
+            }
+            sinkPutc(sink, '}');
+        }
+        // A thread may have named itself and recorded nothing, as a worker whose tasks were all stolen
+        if (buffer->name)
+            _thread_name(sink, buffer->tid, buffer->name, &first);
+    }
+    // A row each after the threads, from the start as clang does
+    for (int i = 0; i < total_count; i++) {
+        int tid = thread_count + 1 + i;
+        char name[TOTAL_NAME_SIZE];
+        snprintf(name, sizeof(name), "Total %s", totals[i].name);
+        _event(sink, name, tid, 0, totals[i].nanoseconds, &first);
+        sinkPrintf(sink, ",\"args\":{\"count\":%llu,\"avg ms\":%.6f}}",
+            (unsigned long long)totals[i].count, totals[i].nanoseconds / 1e6 / totals[i].count);
+        _thread_name(sink, tid, name, &first);
+    }
+    sinkPuts(sink, "\n],\"displayTimeUnit\":\"ms\"}\n");
+
+    while (buffers) {
+        Buffer *next = buffers->next;
+        arenaTerminate(buffers->strings);
+        free(buffers->events);
+        free(buffers);
+        buffers = next;
+    }
+    local = NULL;
+    total_count = 0;
+    pthread_mutex_unlock(&mutex);
+    int status = sinkTerminate(sink);
+    return close(fd) || status ? -1 : 0;
+}
@@ -0,0 +1,24 @@
+#ifndef TRACE_H
+#define TRACE_H
+#include <stdbool.h>
+#include <stdint.h>
+
+
+/*
+ * Time spent in named scopes, written out as Chrome trace JSON for a trace
+ * viewer. Each thread records into a buffer of its own, so recording takes
+ * no lock. A scope is traceBegin then traceEnd; while tracing is off they
+ * only test a flag. Totals added with traceTotal are summed over threads
+ * and come out as one bar each, for what is too fine to record scope by scope.
+*/
+extern bool traceOn;
+
+
+void traceStart(void);
+uint64_t traceNow(void);
+uint64_t traceBegin(void);
+void traceEnd(const char *p_name, const char *p_detail, uint64_t p_start);
+void traceTotal(const char *p_name, uint64_t p_nanoseconds, uint64_t p_count);
+void traceNameThread(const char *p_name);
+int traceWrite(const char *p_path);
+#endif // TRACE_H
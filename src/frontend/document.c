@@ -0,0 +1,332 @@
+#include "document.h"
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+
+#define NO_DECLARATION SIZE_MAX
+// Replaced declarations stay in the arena until it holds this many times a fresh tree
+#define COMPACT_RATIO 2
+#define COMPACT_MIN (1024 * 1024)
+
+
+/*
+ * A top level declaration: where its let is and what it parsed to. A
+ * declaration without a node stands for text from there on that did not
+ * parse at the last edit.
+*/
+typedef struct {
+	uint32_t offset;
+	int line;
+	Node *node;
+} Declaration;
+
+
+typedef struct {
+	Declaration *items;
+	size_t count;
+	size_t capacity;
+} DeclarationList;
+
+
+struct Document {
+	char *text;
+	size_t size;
+	size_t capacity;
+	const char *source;
+	Arena *arena;
+	// The tree of the last text that parsed
+	Node *root;
+	DeclarationList declarations;
+	// The declaration without a node, NO_DECLARATION when the text parses
+	size_t broken;
+	// Arena used right after the last full parse
+	size_t live;
+	size_t reparsed;
+};
+
+
+static void _list_push(DeclarationList *p_list, Declaration p_declaration) {
+	if (p_list->count == p_list->capacity) {
+		size_t capacity = p_list->capacity ? p_list->capacity * 2 : 64;
+		Declaration *grown = (Declaration*)realloc(p_list->items, capacity * sizeof(Declaration));
+		if (!grown)
+			abort();
+		p_list->items = grown;
+		p_list->capacity = capacity;
+	}
+	p_list->items[p_list->count++] = p_declaration;
+}
+
+
+/*
+ * Replaces p_removed declarations from p_index on with those of p_with.
+*/
+static void _list_splice(DeclarationList *p_list, size_t p_index, size_t p_removed, const DeclarationList *p_with) {
+	size_t count = p_list->count - p_removed + p_with->count;
+	if (count > p_list->capacity) {
+		Declaration *grown = (Declaration*)realloc(p_list->items, count * sizeof(Declaration));
+		if (!grown)
+			abort();
+		p_list->items = grown;
+		p_list->capacity = count;
+	}
+	Declaration *at = p_list->items + p_index;
+	memmove(at + p_with->count, at + p_removed, (p_list->count - p_index - p_removed) * sizeof(Declaration));
+	memcpy(at, p_with->items, p_with->count * sizeof(Declaration));
+	p_list->count = count;
+}
+
+
+static int _count_lines(const char *p_text, size_t p_size) {
+	int lines = 0;
+	for (const char *c = p_text, *end = p_text + p_size; (c = memchr(c, '\n', end - c)); c++)
+		lines++;
+	return lines;
+}
+
+
+/*
+ * The first declaration whose let is at p_offset or after it.
+*/
+static size_t _find(const DeclarationList *p_list, uint64_t p_offset) {
+	size_t low = 0, high = p_list->count;
+	while (low < high) {
+		size_t middle = low + (high - low) / 2;
+		if (p_list->items[middle].offset < p_offset)
+			low = middle + 1;
+		else
+			high = middle;
+	}
+	return low;
+}
+
+
+/*
+ * Parses declarations into p_out from p_offset, which is on line p_line,
+ * until the text ends or a let lands where old declaration p_sync or one
+ * after it started, once shifted by p_shift. p_kept is then the index of
+ * that declaration, the count of them otherwise.
+*/
+static int _parse_until_sync(Document *p_document, uint32_t p_offset, int p_line, size_t p_sync, int64_t p_shift,
+		DeclarationList *p_out, size_t *p_kept) {
+	const DeclarationList *old = &p_document->declarations;
+	Tokenizer *tk = tokenizerInitBuffer(p_document->text, p_document->size, p_document->source);
+	if (!tk)
+		abort();
+	tokenizerStartAt(tk, p_offset, p_line);
+	Parser *parser = parserInitArena(tk, p_document->arena);
+	*p_kept = old->count;
+	int status;
+	while (true) {
+		Token *token = tokenizerGetCurrent(tk);
+		Declaration declaration = {
+			.offset = tokenizerTokenGetOffset(token),
+			.line = tokenizerTokenGetLine(token),
+		};
+		if (tokenizerTokenGetType(token) == TK_LET) {
+			while (p_sync < old->count && old->items[p_sync].offset + p_shift < declaration.offset)
+				p_sync++;
+			// Lexing has no state between tokens, from a let of the old text on nothing changed
+			if (p_sync < old->count && old->items[p_sync].offset + p_shift == declaration.offset) {
+				*p_kept = p_sync;
+				status = 0;
+				break;
+			}
+		}
+		if ((status = parserParseDeclaration(parser)))
+			break;
+		if (!(declaration.node = parserGetRoot(parser)))
+			break;
+		_list_push(p_out, declaration);
+	}
+	parserTerminate(parser);
+	tokenizerTerminate(tk);
+	return status;
+}
+
+
+static void _build_root(Document *p_document) {
+	p_document->root = nodeSpaceCreate(p_document->arena);
+	for (size_t i = 0; i < p_document->declarations.count; i++)
+		nodeSpaceAddChild(p_document->arena, p_document->root, p_document->declarations.items[i].node);
+}
+
+
+/*
+ * The whole text into a fresh arena, which also drops what earlier edits
+ * left behind.
+*/
+static int _parse_all(Document *p_document) {
+	Arena *old = p_document->arena;
+	p_document->arena = arenaInit(0);
+	if (!p_document->arena)
+		abort();
+	DeclarationList fresh = {0};
+	size_t kept;
+	p_document->declarations.count = 0;
+	int status = _parse_until_sync(p_document, 0, 1, 0, 0, &fresh, &kept);
+	p_document->reparsed = fresh.count;
+	if (status) {
+		fresh.count = 0;
+		_list_push(&fresh, (Declaration){.offset = 0, .line = 1, .node = NULL});
+		p_document->broken = 0;
+		p_document->root = NULL;
+	}
+	free(p_document->declarations.items);
+	p_document->declarations = fresh;
+	if (!status) {
+		p_document->broken = NO_DECLARATION;
+		_build_root(p_document);
+	}
+	p_document->live = arenaGetUsed(p_document->arena);
+	if (old)
+		arenaTerminate(old);
+	return status;
+}
+
+
+Document *documentInit(const char *p_text, size_t p_size, const char *p_source) {
+	Document *document = (Document*)malloc(sizeof(Document));
+	if (!document)
+		return NULL;
+	*document = (Document){
+		.text = (char*)malloc(p_size + 1),
+		.size = p_size,
+		.capacity = p_size + 1,
+		.source = p_source,
+		.arena = NULL,
+		.root = NULL,
+		.declarations = {0},
+		.broken = NO_DECLARATION,
+	};
+	if (!document->text) {
+		free(document);
+		return NULL;
+	}
+	memcpy(document->text, p_text, p_size);
+	document->text[p_size] = '\0';
+	_parse_all(document);
+	return document;
+}
+
+
+/*
+ * Replaces p_removed bytes at p_offset with the p_length bytes of
+ * p_inserted. Errors are reported as parserParse would, the root then stays
+ * the tree of the last text that parsed.
+*/
+int documentEdit(Document *p_document, uint32_t p_offset, uint32_t p_removed, const char *p_inserted, size_t p_length) {
+	if ((size_t)p_offset + p_removed > p_document->size || p_document->size - p_removed + p_length > UINT32_MAX)
+		return -1;
+	int removed_lines = _count_lines(p_document->text + p_offset, p_removed);
+	size_t size = p_document->size - p_removed + p_length;
+	if (size + 1 > p_document->capacity) {
+		size_t capacity = p_document->capacity * 2 > size + 1 ? p_document->capacity * 2 : size + 1;
+		char *grown = (char*)realloc(p_document->text, capacity);
+		if (!grown)
+			abort();
+		p_document->text = grown;
+		p_document->capacity = capacity;
+	}
+	char *at = p_document->text + p_offset;
+	memmove(at + p_length, at + p_removed, p_document->size - p_offset - p_removed);
+	memcpy(at, p_inserted, p_length);
+	p_document->size = size;
+	p_document->text[size] = '\0';
+	int64_t shift = (int64_t)p_length - p_removed;
+	int line_shift = _count_lines(p_inserted, p_length) - removed_lines;
+
+	// An edit right on a let may extend the declaration before it, which ends there
+	DeclarationList *declarations = &p_document->declarations;
+	size_t first = _find(declarations, p_offset);
+	first -= first > 0;
+	size_t broken = p_document->broken;
+	if (broken < first)
+		first = broken;
+	uint32_t offset = 0;
+	int line = 1;
+	if (first < declarations->count && declarations->items[first].offset < p_offset) {
+		offset = declarations->items[first].offset;
+		line = declarations->items[first].line;
+	} else {
+		first = 0;
+	}
+	// Only lets the edit left alone can be where the tokens fall back in step
+	size_t sync = _find(declarations, (uint64_t)p_offset + p_removed);
+	if (broken != NO_DECLARATION && sync <= broken)
+		sync = broken + 1;
+
+	DeclarationList fresh = {0};
+	size_t kept;
+	int status = _parse_until_sync(p_document, offset, line, sync, shift, &fresh, &kept);
+	p_document->reparsed = fresh.count;
+	if (status) {
+		// Everything up to the next let past the edit waits for a later edit
+		fresh.count = 0;
+		_list_push(&fresh, (Declaration){.offset = offset, .line = line, .node = NULL});
+		kept = sync > first ? sync : first + 1;
+		if (kept > declarations->count)
+			kept = declarations->count;
+	}
+	for (size_t i = kept; i < declarations->count; i++) {
+		declarations->items[i].offset += shift;
+		declarations->items[i].line += line_shift;
+	}
+	if (!status && broken == NO_DECLARATION) {
+		Node **nodes = (Node**)malloc((fresh.count + 1) * sizeof(Node*));
+		if (!nodes)
+			abort();
+		for (size_t i = 0; i < fresh.count; i++)
+			nodes[i] = fresh.items[i].node;
+		nodeSpaceReplace(p_document->arena, p_document->root, first, kept - first, nodes, fresh.count);
+		free(nodes);
+	}
+	_list_splice(declarations, first, kept - first, &fresh);
+	free(fresh.items);
+	if (status) {
+		p_document->broken = first;
+		return status;
+	}
+	// The old tree does not match the declarations of a text that did not parse
+	if (broken != NO_DECLARATION) {
+		p_document->broken = NO_DECLARATION;
+		_build_root(p_document);
+	}
+	if (arenaGetUsed(p_document->arena) > COMPACT_RATIO * p_document->live + COMPACT_MIN) {
+		size_t reparsed = p_document->reparsed;
+		status = _parse_all(p_document);
+		p_document->reparsed = reparsed;
+	}
+	return status;
+}
+
+
+Node *documentGetRoot(const Document *p_document) {
+	return p_document->root;
+}
+
+
+/*
+ * The text after every edit so far, terminated.
+*/
+const char *documentGetText(const Document *p_document, size_t *p_size) {
+	*p_size = p_document->size;
+	return p_document->text;
+}
+
+
+/*
+ * How many declarations the last edit parsed, the others were kept.
+*/
+size_t documentGetReparsed(const Document *p_document) {
+	return p_document->reparsed;
+}
+
+
+void documentTerminate(Document *p_document) {
+	arenaTerminate(p_document->arena);
+	free(p_document->declarations.items);
+	free(p_document->text);
+	free(p_document);
+}
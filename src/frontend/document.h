@@ -0,0 +1,23 @@
+#ifndef DOCUMENT_H
+#define DOCUMENT_H
+
+#include "parser.h"
+
+/*
+ * A text kept parsed across edits, for editors and watchers. An edit is
+ * parsed again from the top level declaration it reaches into, up to where
+ * the tokens start over on an old declaration: that one and every one after
+ * it are kept as they are.
+*/
+typedef struct Document Document;
+
+
+Document *documentInit(const char *p_text, size_t p_size, const char *p_source);
+int documentEdit(Document *p_document, uint32_t p_offset, uint32_t p_removed, const char *p_inserted, size_t p_length);
+Node *documentGetRoot(const Document *p_document);
+const char *documentGetText(const Document *p_document, size_t *p_size);
+size_t documentGetReparsed(const Document *p_document);
+void documentTerminate(Document *p_document);
+
+
+#endif // DOCUMENT_H
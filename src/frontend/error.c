@@ -8,7 +8,7 @@ void errorExpectedToken(const TokenType p_expected, const Token *p_found) {
     printf("\x1b[1m%s:%d: \x1b[91merror:\x1b[1;97m Expected \"\x1b[96m%s\x1b[97m\", ", tokenizerTokenGetSource(p_found), tokenizerTokenGetLine(p_found), tokenizerTokenTypeName(p_expected));
     switch (tokenizerTokenGetType(p_found)) {
         case TK_IDENTIFIER:
-            printf("found \x1b[96mIDENTFIRE\x1b[97m: \"%s\"", (char*)literalGetVal(tokenizerTokenGetLiteral(p_found)));
+            printf("found \x1b[96mIDENTFIRE\x1b[97m: \"%.*s\"", (int)tokenizerTokenGetLength(p_found), tokenizerTokenGetText(p_found));
             break;
         case TK_ERROR:
             printf(tokenizerTokenGetErrorString(p_found));
@@ -23,7 +23,7 @@ void errorExpected(const char *p_expected, const Token *p_found) {
     printf("\x1b[1m%s:%d: \x1b[91merror:\x1b[1;97m Expected \x1b[96m%s\x1b[97m, ", tokenizerTokenGetSource(p_found), tokenizerTokenGetLine(p_found), p_expected);
     switch (tokenizerTokenGetType(p_found)) {
         case TK_IDENTIFIER:
-            printf("found \x1b[96mIDENTFIRE\x1b[97m: \"%s\"", (char*)literalGetVal(tokenizerTokenGetLiteral(p_found)));
+            printf("found \x1b[96mIDENTFIRE\x1b[97m: \"%.*s\"", (int)tokenizerTokenGetLength(p_found), tokenizerTokenGetText(p_found));
             break;
         case TK_ERROR:
             printf("Tokenizer Error: %s", tokenizerTokenGetErrorString(p_found));
@@ -0,0 +1,62 @@
+/* This file is generated by tools/gen_keywords.py from the TokenType enum and
+ * token_names. Do not edit! */
+
+#ifndef KEYWORDS_H
+#define KEYWORDS_H
+
+#include <stdint.h>
+
+#define KEYWORD_MIN_LENGTH 2
+#define KEYWORD_MAX_LENGTH 10
+#define KEYWORD_HASH(S, L) (((uint8_t)(S)[0] * 14u ^ (uint8_t)(S)[(L) - 1] * 4u ^ (uint32_t)(L)) & 127u)
+
+static const struct {
+	const char *name;
+	uint8_t length;
+	uint8_t type;
+} keyword_table[128] = {
+	[0] = {"as", 2, TK_AS},
+	[4] = {"in", 2, TK_IN},
+	[6] = {"breakpoint", 10, TK_BREAKPOINT},
+	[7] = {"super", 5, TK_SUPER},
+	[11] = {"yield", 5, TK_YIELD},
+	[13] = {"trait", 5, TK_TRAIT},
+	[19] = {"while", 5, TK_WHILE},
+	[22] = {"else", 4, TK_ELSE},
+	[24] = {"assert", 6, TK_ASSERT},
+	[26] = {"elif", 4, TK_ELIF},
+	[27] = {"await", 5, TK_AWAIT},
+	[28] = {"struct", 6, TK_STRUCT},
+	[35] = {"class", 5, TK_CLASS},
+	[36] = {"if", 2, TK_IF},
+	[46] = {"fn", 2, TK_FN},
+	[54] = {"enum", 4, TK_ENUM},
+	[55] = {"preload", 7, TK_PRELOAD},
+	[59] = {"let", 3, TK_LET},
+	[62] = {"when", 4, TK_WHEN},
+	[63] = {"const", 5, TK_CONST},
+	[64] = {"static", 6, TK_STATIC},
+	[70] = {"PI", 2, TK_CONST_PI},
+	[72] = {"type", 4, TK_TYPE},
+	[77] = {"extends", 7, TK_EXTENDS},
+	[79] = {"TAU", 3, TK_CONST_TAU},
+	[83] = {"match", 5, TK_MATCH},
+	[86] = {"self", 4, TK_SELF},
+	[87] = {"not", 3, TK_NOT},
+	[88] = {"or", 2, TK_OR},
+	[91] = {"space", 5, TK_SPACE},
+	[93] = {"and", 3, TK_AND},
+	[95] = {"for", 3, TK_FOR},
+	[96] = {"void", 4, TK_VOID},
+	[101] = {"INF", 3, TK_CONST_INF},
+	[104] = {"pass", 4, TK_PASS},
+	[111] = {"ret", 3, TK_RET},
+	[112] = {"is", 2, TK_IS},
+	[116] = {"class_name", 10, TK_CLASS_NAME},
+	[117] = {"break", 5, TK_BREAK},
+	[118] = {"continue", 8, TK_CONTINUE},
+	[124] = {"signal", 6, TK_SIGNAL},
+	[127] = {"NaN", 3, TK_CONST_NAN},
+};
+
+#endif // KEYWORDS_H
@@ -1,55 +1,148 @@
 #include "literal.h"
+#include "../extra/stats.h"
 
 #include <stdint.h>
 #include <stdlib.h>
 #include <string.h>
 #include <assert.h>
 
-struct Literal {
-    LiteralType type;
-    void* val;
+
+static const char *suffix_names[] = {
+    "", // LS_NONE
+    "i8", // LS_I8
+    "i16", // LS_I16
+    "i32", // LS_I32
+    "i64", // LS_I64
+    "u8", // LS_U8
+    "u16", // LS_U16
+    "u32", // LS_U32
+    "u64", // LS_U64
+    "f32", // LS_F32
+    "f64", // LS_F64
 };
 
 
-Literal *literalCreate(const LiteralType p_type, const void *p_data) {
-    Literal *lt = (Literal*)malloc(sizeof(Literal));
-    lt->type = p_type;
-    switch (p_type) {
-        case LT_INT:
-            lt->val = malloc(sizeof(int));
-            *(int*)lt->val = *(int*)p_data;
-            break;
-        case LT_FLOAT:
-            lt->val = malloc(sizeof(float));
-            *(float*)lt->val = *(float*)p_data;
-            break;
-        case LT_STRING:
-            lt->val = malloc(sizeof(char) * strlen(p_data));
-            strcpy(lt->val, p_data);
-            break;
+// Every power of ten up to 1e22 is exact in a double
+static const double exact_powers_of_ten[] = {
+    1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+    1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+};
+
+// Same for floats up to 1e10
+static const float exact_powers_of_ten_f[] = {
+    1e0f, 1e1f, 1e2f, 1e3f, 1e4f, 1e5f, 1e6f, 1e7f, 1e8f, 1e9f, 1e10f
+};
+
+
+Literal literalCreateInt(int64_t p_val, LiteralSuffix p_suffix) {
+    return (Literal){ .type = LT_INT, .suffix = p_suffix, .i = p_val };
+}
+
+Literal literalCreateUInt(uint64_t p_val, LiteralSuffix p_suffix) {
+    return (Literal){ .type = LT_UINT, .suffix = p_suffix, .u = p_val };
+}
+
+Literal literalCreateFloat(double p_val, LiteralSuffix p_suffix) {
+    return (Literal){ .type = LT_FLOAT, .suffix = p_suffix, .f = p_val };
+}
+
+Literal literalCreateString(const char *p_raw, size_t p_length) {
+    return (Literal){
+        .type = LT_STRING,
+        .suffix = LS_NONE,
+        .str = { .raw = p_raw, .raw_length = p_length, .decoded = NULL }
+    };
+}
+
+/*
+ * Clinger's fast path: when the mantissa and the power of ten are both exact
+ * in the target type, one correctly rounded multiply or divide gives the
+ * correctly rounded result. Returns false when the caller has to fall back to
+ * a full conversion.
+*/
+bool literalFloatFromDecimal(uint64_t p_mantissa, int p_exponent, bool p_single, double *p_out) {
+    if (p_single) {
+        if (p_mantissa > (UINT64_C(1) << 24) || p_exponent < -10 || p_exponent > 10)
+            return false;
+        float val = (float)p_mantissa;
+        if (p_exponent < 0)
+            val /= exact_powers_of_ten_f[-p_exponent];
+        else
+            val *= exact_powers_of_ten_f[p_exponent];
+        *p_out = val;
+        return true;
     }
-    return lt;
+    if (p_mantissa > (UINT64_C(1) << 53) || p_exponent < -22 || p_exponent > 22)
+        return false;
+    double val = (double)p_mantissa;
+    if (p_exponent < 0)
+        val /= exact_powers_of_ten[-p_exponent];
+    else
+        val *= exact_powers_of_ten[p_exponent];
+    *p_out = val;
+    return true;
+}
+
+size_t literalStringDecode(const char *p_raw, size_t p_length, char *p_out) {
+    size_t len = 0;
+    for (const char *end = p_raw + p_length; p_raw < end; p_raw++) {
+        char c = *p_raw;
+        if (c == '\\' && p_raw + 1 < end) {
+            switch (c = *++p_raw) {
+                case 'n': c = '\n'; break;
+                case 't': c = '\t'; break;
+                case 'r': c = '\r'; break;
+                case '0': c = '\0'; break;
+                default: break;
+            }
+        }
+        p_out[len++] = c;
+    }
+    p_out[len] = '\0';
+    return len;
 }
 
 LiteralType literalGetType(const Literal *p_lt) {
     return p_lt->type;
 }
 
-void *literalGetVal(const Literal* p_lt) {
-    return p_lt->val;
+LiteralSuffix literalGetSuffix(const Literal *p_lt) {
+    return p_lt->suffix;
 }
 
-const char *literalStringGetVal(const Literal *p_lt) {
-    assert(p_lt && p_lt->type);
-    return (char*)p_lt->val;
+const char *literalSuffixName(LiteralSuffix p_suffix) {
+    return suffix_names[p_suffix];
 }
 
-void literalFree(Literal *p_lt) {
-    if(!p_lt)
-        return;
-    free(p_lt->val);
-	free(p_lt);
+void *literalGetVal(const Literal* p_lt) {
+    switch (p_lt->type) {
+        case LT_INT:
+            return (void*)&p_lt->i;
+        case LT_UINT:
+            return (void*)&p_lt->u;
+        case LT_FLOAT:
+            return (void*)&p_lt->f;
+        case LT_STRING:
+            return (void*)literalStringGetVal(p_lt);
+    }
+    return NULL;
 }
 
+const char *literalStringGetVal(const Literal *p_lt) {
+    assert(p_lt && p_lt->type == LT_STRING);
+    if (!p_lt->str.decoded && p_lt->str.raw) {
+        // Decoding never grows the text, the raw length is enough room
+        char *decoded = (char*)malloc(p_lt->str.raw_length + 1);
+        STATS_ADD(STAT_LITERAL_BYTES, p_lt->str.raw_length + 1);
+        literalStringDecode(p_lt->str.raw, p_lt->str.raw_length, decoded);
+        ((Literal*)p_lt)->str.decoded = decoded;
+    }
+    return p_lt->str.decoded;
+}
 
-
+void literalRelease(Literal *p_lt) {
+    if (p_lt && p_lt->type == LT_STRING) {
+        free(p_lt->str.decoded);
+        p_lt->str.decoded = NULL;
+    }
+}
@@ -1,19 +1,62 @@
 #ifndef LITERAL_H
 #define LITERAL_H
 
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
 
 typedef enum {
     LT_INT,
+    LT_UINT,
     LT_FLOAT,
     LT_STRING
 } LiteralType;
 
-typedef struct Literal Literal;
+typedef enum {
+    LS_NONE,
+    LS_I8,
+    LS_I16,
+    LS_I32,
+    LS_I64,
+    LS_U8,
+    LS_U16,
+    LS_U32,
+    LS_U64,
+    LS_F32,
+    LS_F64
+} LiteralSuffix;
+
+/*
+ * Literals are small values stored inline by their owner (the token storage),
+ * only a decoded string ever lives on the heap.
+*/
+typedef struct Literal {
+    LiteralType type;
+    LiteralSuffix suffix;
+    union {
+        int64_t i;
+        uint64_t u;
+        double f;
+        struct {
+            // The escaped source text, decoded on demand
+            const char *raw;
+            size_t raw_length;
+            char *decoded;
+        } str;
+    };
+} Literal;
 
-Literal *literalCreate(const LiteralType p_type, const void *p_data);
+Literal literalCreateInt(int64_t p_val, LiteralSuffix p_suffix);
+Literal literalCreateUInt(uint64_t p_val, LiteralSuffix p_suffix);
+Literal literalCreateFloat(double p_val, LiteralSuffix p_suffix);
+Literal literalCreateString(const char *p_raw, size_t p_length);
+bool literalFloatFromDecimal(uint64_t p_mantissa, int p_exponent, bool p_single, double *p_out);
+size_t literalStringDecode(const char *p_raw, size_t p_length, char *p_out);
 LiteralType literalGetType(const Literal *p_lt);
+LiteralSuffix literalGetSuffix(const Literal *p_lt);
+const char *literalSuffixName(LiteralSuffix p_suffix);
 void *literalGetVal(const Literal *p_lt);
 const char *literalStringGetVal(const Literal *p_lt);
-void literalFree(Literal *p_lt);
+void literalRelease(Literal *p_lt);
 
 #endif // LITERAL_H
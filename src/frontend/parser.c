@@ -2,13 +2,16 @@
 #include "error.h"
 
 #include "../syntax_tree/syntax_tree.h"
-#include "../extra/hash.h"
+#include "../extra/stats.h"
+#include "../extra/trace.h"
 #include "tokenizer.h"
 
 #include <stdlib.h>
 #include <stdbool.h>
 #include <stdio.h>
-#include <setjmp.h>
+#include <string.h>
+#include <stdatomic.h>
+#include <pthread.h>
 
 
 typedef enum {
@@ -28,23 +31,158 @@ typedef enum {
 	PROC_EXPRESSION,
 	PROC_EXP_BINARY,
 	PROC_EXP_VALUE,
+	PROC_UNIT,
+	// Resume points are numbered from here on
+	PROC_COUNT
 } ProcType;
 
-typedef int PROC_STATE;
+#define INITIAL_STACK_SIZE 256
+#define INITIAL_EXPRESSION_SIZE 64
+// Smaller pieces are not worth a tokenizer and a parser of their own
+#define MIN_PIECE_SIZE (256 * 1024)
+// More pieces than threads, so that a slow piece does not hold the others up
+#define PIECES_PER_THREAD 4
+// Source name and depth of a parse event
+#define TRACE_DETAIL_SIZE 512
 
-typedef struct ParseCtx {
+
+/*
+ * A pending procedure: where to resume it and the node it is building.
+*/
+typedef struct {
+	int resume;
+	// The procedure itself, resume moves on to its resume points
+	ProcType proc;
 	Node *node;
-	jmp_buf ret_buf;
-	struct ParseCtx *prev_ctx;
-} ParseCtx;
+} ParseFrame;
+
+
+// What each family of procedures is called in a trace
+static const char *const proc_names[PROC_COUNT] = {
+	[PROC_SPACE] = "Parse space",
+	[PROC_SUBSPACE] = "Parse subspace",
+	[PROC_ENUM] = "Parse enum",
+	[PROC_TYPE] = "Parse type",
+	[PROC_IDENTIFIER] = "Parse identifier",
+	[PROC_XIDENTIFIER] = "Parse xidentifier",
+	[PROC_LET] = "Parse let",
+	[PROC_METHOD] = "Parse method",
+	[PROC_SCOPE] = "Parse scope",
+	[PROC_PARAMETER_LIST] = "Parse parameter list",
+	[PROC_PARAM] = "Parse param",
+	[PROC_STATEMENT] = "Parse statement",
+	[PROC_EXPRESSION] = "Parse expression",
+	[PROC_EXP_BINARY] = "Parse binary expression",
+	[PROC_EXP_VALUE] = "Parse value",
+	[PROC_UNIT] = "Parse unit",
+};
+
+
+/*
+ * Binding powers of the expression operators, 0 means the token is not one.
+ * A binary operator captures what follows while its left power is above the
+ * right power of the operator before it, so left < right is left associative.
+*/
+typedef struct {
+	uint8_t left;
+	uint8_t right;
+} BindingPower;
+
+#define PREFIX_POWER 21
+
+static const BindingPower binary_powers[TK_EOF + 1] = {
+	// Assignment, right associative
+	[TK_EQUAL] = {2, 1},
+	[TK_PLUS_EQUAL] = {2, 1},
+	[TK_MINUS_EQUAL] = {2, 1},
+	[TK_STAR_EQUAL] = {2, 1},
+	[TK_STAR_STAR_EQUAL] = {2, 1},
+	[TK_SLASH_EQUAL] = {2, 1},
+	[TK_PERCENT_EQUAL] = {2, 1},
+	[TK_LESS_LESS_EQUAL] = {2, 1},
+	[TK_GREATER_GREATER_EQUAL] = {2, 1},
+	[TK_AMPERSAND_EQUAL] = {2, 1},
+	[TK_PIPE_EQUAL] = {2, 1},
+	[TK_CARET_EQUAL] = {2, 1},
+	// Logical
+	[TK_OR] = {3, 4},
+	[TK_PIPE_PIPE] = {3, 4},
+	[TK_AND] = {5, 6},
+	[TK_AMPERSAND_AMPERSAND] = {5, 6},
+	// Comparison
+	[TK_LESS] = {7, 8},
+	[TK_LESS_EQUAL] = {7, 8},
+	[TK_GREATER] = {7, 8},
+	[TK_GREATER_EQUAL] = {7, 8},
+	[TK_EQUAL_EQUAL] = {7, 8},
+	[TK_BANG_EQUAL] = {7, 8},
+	// Bitwise
+	[TK_PIPE] = {9, 10},
+	[TK_CARET] = {11, 12},
+	[TK_AMPERSAND] = {13, 14},
+	[TK_LESS_LESS] = {15, 16},
+	[TK_GREATER_GREATER] = {15, 16},
+	// Math, unary operators sit at PREFIX_POWER
+	[TK_PLUS] = {17, 18},
+	[TK_MINUS] = {17, 18},
+	[TK_STAR] = {19, 20},
+	[TK_SLASH] = {19, 20},
+	[TK_PERCENT] = {19, 20},
+	// Above prefix so that -a ** b is -(a ** b)
+	[TK_STAR_STAR] = {24, 23},
+};
+
+static const bool prefix_operators[TK_EOF + 1] = {
+	[TK_MINUS] = true,
+	[TK_PLUS] = true,
+	[TK_BANG] = true,
+	[TK_NOT] = true,
+	[TK_TILDE] = true,
+};
+
+
+/*
+ * Pending operator of the expression being parsed, TK_PARENTHESIS_OPEN marks
+ * a group.
+*/
+typedef struct {
+	TokenType type;
+	uint8_t power;
+	bool prefix;
+} PendingOperator;
 
 
 struct Parser {
 	Tokenizer *tokenizer;
-	ParseCtx *stack_popped;
-	ParseCtx *stack_top;
+	// Every node of the tree, freed at once
+	Arena *arena;
+	// Parsers of skipped bodies borrow the arena of the whole file
+	bool owns_arena;
+	bool lazy_bodies;
+	const BodyParser *bodies;
+	BodyParser own_bodies;
+	// Skipped bodies that failed once parsed, counted on the parser of the whole file
+	size_t body_errors;
+	// Threads parsing the top level declarations, 1 parses in order
+	int threads;
+	// Errors are left to whoever parses the text again
+	bool quiet;
+	ProcType entry;
+	ParseFrame *frames;
+	int capacity;
+	Node **operands;
+	PendingOperator *operators;
+	int expression_capacity;
+	Node *popped;
+	Node *root;
 	int depth;
 	int max_depth;
+	// Time spent in each family of procedures, not counting what they call
+	bool timed;
+	ProcType timed_proc;
+	uint64_t timed_since;
+	uint64_t proc_time[PROC_COUNT];
+	uint64_t proc_calls[PROC_COUNT];
 };
 
 
@@ -55,21 +193,26 @@ struct Parser {
 #define STR(E) #E
 
 #define ERR_EXPECTED_TERMINAL(TERMINAL) {\
-	printf(__FILE__":%d\n", __LINE__);\
-	errorExpectedToken(TERMINAL, tokenizerGetCurrent(p_parser->tokenizer));\
+	if (!p_parser->quiet) {\
+		printf(__FILE__":%d\n", __LINE__);\
+		errorExpectedToken(TERMINAL, tokenizerGetCurrent(p_parser->tokenizer));\
+	}\
 	_end_parsing(p_parser);\
 	return -1;\
 }
 
 #define ERR_EXPECTED_NON_TERMINAL(NON_TERMINAL) {\
-	printf(__FILE__":%d\n", __LINE__);\
-	errorExpected(NON_TERMINAL, tokenizerGetCurrent(p_parser->tokenizer));\
+	if (!p_parser->quiet) {\
+		printf(__FILE__":%d\n", __LINE__);\
+		errorExpected(NON_TERMINAL, tokenizerGetCurrent(p_parser->tokenizer));\
+	}\
 	_end_parsing(p_parser);\
 	return -1;\
 }
 
 #define ERR_UNREACHABLE() {\
-	puts("\x1b[1;91mInternal Error:\x1b[1;97m unreachable.\x1b[0m");\
+	if (!p_parser->quiet)\
+		puts("\x1b[1;91mInternal Error:\x1b[1;97m unreachable.\x1b[0m");\
 	_end_parsing(p_parser);\
 	return -1;\
 }
@@ -79,97 +222,276 @@ struct Parser {
 ***************/
 
 
-void _free_ctx(ParseCtx *p_ctx) {
-	free(p_ctx);
+static ParseFrame *_stack_push(Parser* p_parser, ProcType p_proc) {
+	STATS_ADD(STAT_FRAMES, 1);
+	if (++p_parser->depth == p_parser->capacity) {
+		int capacity = p_parser->capacity * 2;
+		ParseFrame *grown = (ParseFrame*)realloc(p_parser->frames, capacity * sizeof(ParseFrame));
+		if (!grown)
+			abort();
+		STATS_ADD(STAT_FRAME_BYTES, (capacity - p_parser->capacity) * sizeof(ParseFrame));
+		p_parser->frames = grown;
+		p_parser->capacity = capacity;
+	}
+	if (p_parser->depth > p_parser->max_depth)
+		p_parser->max_depth = p_parser->depth;
+	ParseFrame *frame = &p_parser->frames[p_parser->depth];
+	*frame = (ParseFrame){
+		.resume = p_proc,
+		.proc = p_proc,
+		.node = NULL
+	};
+	return frame;
 }
 
 
-ParseCtx *_create_ctx() {
-	ParseCtx *ctx = (ParseCtx*)malloc(sizeof(ParseCtx));
-	ctx->node = NULL;
-	ctx->prev_ctx = NULL;
-	return ctx;
+static void _expression_reserve(Parser *p_parser, int p_size) {
+	if (p_size <= p_parser->expression_capacity)
+		return;
+	int capacity = p_parser->expression_capacity * 2;
+	Node **operands = (Node**)realloc(p_parser->operands, capacity * sizeof(Node*));
+	if (operands)
+		p_parser->operands = operands;
+	PendingOperator *operators = (PendingOperator*)realloc(p_parser->operators, capacity * sizeof(PendingOperator));
+	if (operators)
+		p_parser->operators = operators;
+	if (!operands || !operators)
+		abort();
+	p_parser->expression_capacity = capacity;
 }
 
 
-ParseCtx *_stack_push(Parser* p_parser) {
-	p_parser->depth++;
-	if (p_parser->depth > p_parser->max_depth)
-		p_parser->max_depth = p_parser->depth;
-	ParseCtx *ctx = _create_ctx();
-	ctx->prev_ctx = p_parser->stack_top;
-	p_parser->stack_top = ctx;
-	return ctx;
+/*
+ * Folds the top operator into a node over the top operands.
+*/
+static void _expression_reduce(Parser *p_parser, int *p_operands, int *p_operators) {
+	PendingOperator op = p_parser->operators[--*p_operators];
+	Node **operands = p_parser->operands;
+	if (op.prefix) {
+		operands[*p_operands - 1] = nodeUnaryCreate(p_parser->arena, op.type, operands[*p_operands - 1]);
+		return;
+	}
+	Node *right = operands[--*p_operands];
+	operands[*p_operands - 1] = nodeBinaryCreate(p_parser->arena, op.type, operands[*p_operands - 1], right);
 }
 
 
-ParseCtx *_stack_pop(Parser* p_parser) {
-	p_parser->depth--;
-	_free_ctx(p_parser->stack_popped);
-	p_parser->stack_popped = p_parser->stack_top;
-	if (p_parser->stack_popped)
-		p_parser->stack_top = p_parser->stack_top->prev_ctx;
-	return p_parser->stack_popped;
+/*
+ * Tells a method "(a: T, b) T {" from a parenthesized expression after "=".
+*/
+static bool _is_method_ahead(Parser *p_parser) {
+	Tokenizer *tk = p_parser->tokenizer;
+	switch (tokenizerPeekType(tk, 1)) {
+		case TK_PARENTHESIS_CLOSE:
+			return true;
+		case TK_IDENTIFIER:
+			break;
+		default:
+			return false;
+	}
+	switch (tokenizerPeekType(tk, 2)) {
+		case TK_COLON:
+		case TK_COMMA:
+			return true;
+		case TK_PARENTHESIS_CLOSE:
+			break;
+		default:
+			return false;
+	}
+	// "(a)" alone: a method goes on with its type or its scope
+	TokenType after = tokenizerPeekType(tk, 3);
+	return after == TK_BRACE_OPEN || after == TK_IDENTIFIER;
 }
 
 
-void _stack_pop_then_free(Parser* p_parser) {
-	_free_ctx(_stack_pop(p_parser));
-	p_parser->stack_popped = NULL;
+void _end_parsing(Parser *p_parser) {
+	// Nothing of a half built tree is kept
+	if (p_parser->owns_arena)
+		arenaReset(p_parser->arena);
+	p_parser->root = NULL;
 }
 
 
-void _end_parsing(Parser *p_parser) {
-	// FIXME: Free the syntax tree
-}
+static int _parse(Parser *p_parser, ProcType p_entry);
 
-Parser* parserInit(Tokenizer *p_tokenizer) {
+
+static Parser *_create_parser(Tokenizer *p_tokenizer, Arena *p_arena) {
 	Parser *p = (Parser*)malloc(sizeof(Parser));
 	p->tokenizer = p_tokenizer;
-	p->stack_top = NULL;
-	p->depth = 0;
+	p->arena = p_arena;
+	p->owns_arena = false;
+	p->lazy_bodies = false;
+	p->bodies = NULL;
+	p->body_errors = 0;
+	p->threads = 1;
+	p->quiet = false;
+	p->entry = PROC_SPACE;
+	p->frames = (ParseFrame*)malloc(INITIAL_STACK_SIZE * sizeof(ParseFrame));
+	p->capacity = INITIAL_STACK_SIZE;
+	STATS_ADD(STAT_FRAME_BYTES, INITIAL_STACK_SIZE * sizeof(ParseFrame));
+	p->operands = (Node**)malloc(INITIAL_EXPRESSION_SIZE * sizeof(Node*));
+	p->operators = (PendingOperator*)malloc(INITIAL_EXPRESSION_SIZE * sizeof(PendingOperator));
+	p->expression_capacity = INITIAL_EXPRESSION_SIZE;
+	p->popped = NULL;
+	p->root = NULL;
+	p->depth = -1;
 	p->max_depth = 0;
+	p->timed = false;
 	return p;
 }
 
 
-int parserParse(Parser *p_parser) {
-	#define PROC(P) P:
-	#define ctx p_parser->stack_top
-	#define CALL(F) {if (!setjmp(ctx->ret_buf)) {_stack_push(p_parser); goto F;}}
-	#define RETURN {_stack_pop(p_parser); longjmp(ctx->ret_buf, 1);}
+/*
+ * A skipped body, parsed by a parser of its own over the same text and into
+ * the same arena. The bodies within it are skipped in turn. A body that
+ * fails is reported as the file would be and counted on it.
+*/
+static Node *_parse_body(void *p_ctx, uint32_t p_offset, int p_line) {
+	Parser *unit = (Parser*)p_ctx;
+	size_t size;
+	const char *text = tokenizerGetBuffer(unit->tokenizer, &size);
+	Tokenizer *tk = tokenizerInitBuffer(text, size, tokenizerGetSource(unit->tokenizer));
+	if (!tk)
+		return NULL;
+	tokenizerStartAt(tk, p_offset, p_line);
+	Parser *body = _create_parser(tk, unit->arena);
+	body->lazy_bodies = true;
+	body->bodies = unit->bodies;
+	body->quiet = unit->quiet;
+	Node *scope = _parse(body, PROC_SCOPE) ? NULL : body->root;
+	if (!scope)
+		unit->body_errors++;
+	parserTerminate(body);
+	tokenizerTerminate(tk);
+	return scope;
+}
+
+
+Parser* parserInit(Tokenizer *p_tokenizer) {
+	Parser *p = _create_parser(p_tokenizer, arenaInit(0));
+	p->owns_arena = true;
+	p->own_bodies = (BodyParser){_parse_body, p};
+	p->bodies = &p->own_bodies;
+	return p;
+}
+
+
+/*
+ * A parser that builds into p_arena and never resets it, for trees made of
+ * several parses.
+*/
+Parser *parserInitArena(Tokenizer *p_tokenizer, Arena *p_arena) {
+	Parser *p = _create_parser(p_tokenizer, p_arena);
+	p->own_bodies = (BodyParser){_parse_body, p};
+	p->bodies = &p->own_bodies;
+	return p;
+}
+
+
+/*
+ * Method bodies are skipped by matching braces and only parsed when their
+ * scope is asked for (nodeMethodGetScope), for consumers that only look at
+ * declarations. The tokenizer must then outlive the tree. Streams never
+ * hold their whole text and are always parsed in full.
+*/
+void parserSetLazyBodies(Parser *p_parser, bool p_lazy) {
+	size_t size;
+	p_parser->lazy_bodies = p_lazy && tokenizerGetBuffer(p_parser->tokenizer, &size);
+}
+
+
+/*
+ * Top level declarations are parsed on up to p_threads threads when the
+ * whole text is at hand and nothing of it was lexed yet, in order otherwise.
+ * The tree is the same either way.
+*/
+void parserSetThreads(Parser *p_parser, int p_threads) {
+	p_parser->threads = p_threads > 1 ? p_threads : 1;
+}
+
+
+/*
+ * A quiet parser reports errors through its status only, parse again loud to
+ * print them.
+*/
+void parserSetQuiet(Parser *p_parser, bool p_quiet) {
+	p_parser->quiet = p_quiet;
+}
+
+
+/*
+ * Charges the time since the last switch to the procedure that was running,
+ * p_frame is the one running next. Called on every dispatch, so the clock
+ * is read once per frame entered or resumed; nearly every dispatch changes
+ * family, reading it only then would save next to nothing.
+*/
+static inline void _time_switch(Parser *p_parser, const ParseFrame *p_frame) {
+	uint64_t now = traceNow();
+	p_parser->proc_time[p_parser->timed_proc] += now - p_parser->timed_since;
+	p_parser->timed_since = now;
+	p_parser->timed_proc = p_frame->proc;
+	if (p_frame->resume < PROC_COUNT)
+		p_parser->proc_calls[p_frame->proc]++;
+}
+
+
+/*
+ * The grammar procedures are written as if they were recursive, but every
+ * CALL only pushes a frame and every RETURN pops one: a procedure resumes
+ * through the switch at the case label its CALL left behind.
+*/
+static int _run(Parser *p_parser, ProcType p_entry) {
+	#define PROC(P) case P:
+	#define ctx (&p_parser->frames[p_parser->depth])
+	#define CALL(F) _CALL(F, __COUNTER__)
+	#define _CALL(F, N) {\
+		ctx->resume = PROC_COUNT + N;\
+		_stack_push(p_parser, F);\
+		goto dispatch;\
+		case PROC_COUNT + N:;\
+	}
+	#define RETURN {p_parser->popped = ctx->node; p_parser->depth--; goto dispatch;}
 	#define RET(R) {ctx->node = R; RETURN}
-	#define POPPED p_parser->stack_popped->node
-	_stack_push(p_parser);
-	CALL(PROC_SPACE)
-	if (tokenizerGetCurrentType(p_parser->tokenizer) != TK_EOF)
-		ERR_EXPECTED_TERMINAL(TK_EOF)
-	FILE *f = fopen("./test/test.st", "w");
-	FILE *const std = stdout;
-	stdout = f;
-	nodeExpose(POPPED);
-	stdout = std;
-	fclose(f);
-	return 0;
+	#define POPPED p_parser->popped
+	p_parser->root = NULL;
+	p_parser->entry = p_entry;
+	p_parser->depth = -1;
+	_stack_push(p_parser, PROC_UNIT);
+	// Read once, the calls below could change it for all the compiler knows
+	const bool timed = p_parser->timed;
+
+	dispatch:
+	if (timed)
+		_time_switch(p_parser, ctx);
+	switch (ctx->resume) {
+
+
+	PROC(PROC_UNIT) {
+		CALL(p_parser->entry)
+		// A body ends at its brace, only the whole file has to reach EOF
+		if (p_parser->entry == PROC_SPACE && tokenizerGetCurrentType(p_parser->tokenizer) != TK_EOF)
+			ERR_EXPECTED_TERMINAL(TK_EOF)
+		p_parser->root = POPPED;
+		return 0;
+	}
 
 
 	PROC(PROC_IDENTIFIER) {
 		if (tokenizerGetCurrentType(p_parser->tokenizer) != TK_IDENTIFIER)
 			RET(NULL)
+		ctx->node = nodeIdentifierCreate(p_parser->arena, tokenizerTokenGetSymbol(
+				tokenizerGetCurrent(p_parser->tokenizer)));
 		tokenizerAdvance(p_parser->tokenizer);
-		RET(nodeIdentifierCreate(hashFNV1AStr(
-				literalStringGetVal(
-					tokenizerTokenGetLiteral(
-						tokenizerGetCurrent(p_parser->tokenizer))))))
+		RETURN
 	}
 
 
 	PROC(PROC_SPACE) {
-		ctx->node = nodeSpaceCreate();
+		ctx->node = nodeSpaceCreate(p_parser->arena);
 		while (true) {
 			CALL(PROC_LET)
 			if (POPPED) {
-				nodeSpaceAddChild(ctx->node, POPPED);
+				nodeSpaceAddChild(p_parser->arena, ctx->node, POPPED);
 				continue;
 			}
 			break;
@@ -199,7 +521,7 @@ int parserParse(Parser *p_parser) {
 		CALL(PROC_IDENTIFIER)
 		if (!POPPED)
 			ERR_EXPECTED_TERMINAL(TK_IDENTIFIER)
-		ctx->node = nodeLetCreate(POPPED);
+		ctx->node = nodeLetCreate(p_parser->arena, POPPED);
 		
 		if (tokenizerGetCurrentType(p_parser->tokenizer) == TK_PARENTHESIS_OPEN) {
 			CALL(PROC_METHOD)
@@ -213,21 +535,18 @@ int parserParse(Parser *p_parser) {
 			RETURN
 		tokenizerAdvance(p_parser->tokenizer);
 
-		do {
+		// No CALL inside a switch, its resume label would belong to that switch
+		TokenType value = tokenizerGetCurrentType(p_parser->tokenizer);
+		if (value == TK_SPACE)
 			CALL(PROC_SUBSPACE)
-			if (POPPED)
-				break;
+		else if (value == TK_TYPE || value == TK_STRUCT || value == TK_ENUM)
 			CALL(PROC_TYPE)
-			if (POPPED)
-				break;
+		else if (value == TK_PARENTHESIS_OPEN && _is_method_ahead(p_parser))
 			CALL(PROC_METHOD)
-			if (POPPED)
-				break;
+		else
 			CALL(PROC_EXPRESSION)
-			if (POPPED)
-				break;
+		if (!POPPED)
 			ERR_EXPECTED_NON_TERMINAL("EXPRESSION")
-		} while(false);
 
 		nodeLetSetValue(ctx->node, POPPED);
 		RETURN
@@ -238,7 +557,7 @@ int parserParse(Parser *p_parser) {
 		if (tokenizerGetCurrentType(p_parser->tokenizer) != TK_PARENTHESIS_OPEN)
 			RET(NULL)
 		tokenizerAdvance(p_parser->tokenizer);
-		ctx->node = nodeMethodCreate();
+		ctx->node = nodeMethodCreate(p_parser->arena);
 		CALL(PROC_PARAMETER_LIST)
 		if (POPPED)
 			nodeMethodSetParameters(ctx->node, POPPED);
@@ -248,6 +567,16 @@ int parserParse(Parser *p_parser) {
 		CALL(PROC_TYPE)
 		if (POPPED)
 			nodeMethodSetType(ctx->node, POPPED);
+		if (p_parser->lazy_bodies && tokenizerGetCurrentType(p_parser->tokenizer) == TK_BRACE_OPEN) {
+			Token *brace = tokenizerGetCurrent(p_parser->tokenizer);
+			uint32_t offset = tokenizerTokenGetOffset(brace);
+			int line = tokenizerTokenGetLine(brace);
+			uint32_t end;
+			if (!tokenizerSkipBlock(p_parser->tokenizer, &end))
+				ERR_EXPECTED_TERMINAL(TK_BRACE_CLOSE)
+			nodeMethodSetLazyScope(p_parser->arena, ctx->node, p_parser->bodies, offset, end, line);
+			RETURN
+		}
 		CALL(PROC_SCOPE)
 		if (!POPPED)
 			ERR_EXPECTED_NON_TERMINAL("SCOPE")
@@ -264,8 +593,8 @@ int parserParse(Parser *p_parser) {
 				break;
 
 			if (!ctx->node)
-				ctx->node = nodeParamListCreate();
-			nodeParamListAddParam(ctx->node, POPPED);
+				ctx->node = nodeParamListCreate(p_parser->arena);
+			nodeParamListAddParam(p_parser->arena, ctx->node, POPPED);
 		
 			if (tokenizerGetCurrentType(p_parser->tokenizer) != TK_COMMA)
 				break;
@@ -278,7 +607,7 @@ int parserParse(Parser *p_parser) {
 		CALL(PROC_IDENTIFIER)
 		if (!POPPED)
 				RET(NULL)
-		ctx->node = nodeParamCreate(POPPED);
+		ctx->node = nodeParamCreate(p_parser->arena, POPPED);
 		if (tokenizerGetCurrentType(p_parser->tokenizer) == TK_COLON) {
 			tokenizerAdvance(p_parser->tokenizer);
 			CALL(PROC_TYPE)
@@ -294,19 +623,19 @@ int parserParse(Parser *p_parser) {
 	PROC(PROC_TYPE) {
 		CALL(PROC_IDENTIFIER)
 		if (POPPED)
-			RET(nodeTypeGetById(POPPED))
+			RET(nodeTypeGetById(p_parser->arena, POPPED))
 		switch (tokenizerGetCurrentType(p_parser->tokenizer)) {
 			case TK_TYPE:
 				tokenizerAdvance(p_parser->tokenizer);
-				ctx->node = nodeTypeCreate(TYPE_INTERFACE);
+				ctx->node = nodeTypeCreate(p_parser->arena, TYPE_INTERFACE);
 				RETURN
 			case TK_STRUCT:
 				tokenizerAdvance(p_parser->tokenizer);
-				ctx->node = nodeTypeCreate(TYPE_STRUCTURE);
+				ctx->node = nodeTypeCreate(p_parser->arena, TYPE_STRUCTURE);
 				RETURN
 			case TK_ENUM:
 				tokenizerAdvance(p_parser->tokenizer);
-				ctx->node = nodeTypeCreate(TYPE_ENUM);
+				ctx->node = nodeTypeCreate(p_parser->arena, TYPE_ENUM);
 				RETURN
 			default:
 				RET(NULL)
@@ -318,16 +647,16 @@ int parserParse(Parser *p_parser) {
 		if (tokenizerGetCurrentType(p_parser->tokenizer) != TK_BRACE_OPEN)
 			RET(NULL)
 		tokenizerAdvance(p_parser->tokenizer);
-		ctx->node = nodeScopeCreate();
+		ctx->node = nodeScopeCreate(p_parser->arena);
 		while (true) {
 			CALL(PROC_LET)
 			if (POPPED) {
-				nodeScopeAddChild(ctx->node, POPPED);
+				nodeScopeAddChild(p_parser->arena, ctx->node, POPPED);
 				continue;
 			}
 			CALL(PROC_STATEMENT)
 			if (POPPED) {
-				nodeScopeAddChild(ctx->node, POPPED);
+				nodeScopeAddChild(p_parser->arena, ctx->node, POPPED);
 				continue;
 			}
 			break;
@@ -339,455 +668,293 @@ int parserParse(Parser *p_parser) {
 	}
 
 
+	/*
+	 * Pratt parsing over explicit operand and operator stacks: the whole
+	 * expression, groups included, is folded in one loop without calls.
+	*/
 	PROC(PROC_EXPRESSION) {
-		RET(NULL)
+		Tokenizer *tk = p_parser->tokenizer;
+		int operands = 0;
+		int operators = 0;
+		int groups = 0;
+		while (true) {
+			_expression_reserve(p_parser, operators + 1);
+			Token *token = tokenizerGetCurrent(tk);
+			TokenType type = tokenizerTokenGetType(token);
+			// Expecting an operand
+			if (prefix_operators[type]) {
+				p_parser->operators[operators++] = (PendingOperator){type, PREFIX_POWER, true};
+				tokenizerAdvance(tk);
+				continue;
+			}
+			if (type == TK_PARENTHESIS_OPEN) {
+				p_parser->operators[operators++] = (PendingOperator){type, 0, false};
+				groups++;
+				tokenizerAdvance(tk);
+				continue;
+			}
+			if (type == TK_IDENTIFIER)
+				p_parser->operands[operands++] = nodeIdentifierCreate(p_parser->arena, tokenizerTokenGetSymbol(token));
+			else if (type == TK_LITERAL)
+				p_parser->operands[operands++] = nodeLiteralCreate(p_parser->arena, tokenizerTokenGetLiteral(token));
+			else if (!operators)
+				RET(NULL)
+			else
+				ERR_EXPECTED_NON_TERMINAL("EXPRESSION")
+			type = tokenizerAdvanceType(tk);
+
+			// Then an operator, closing groups on the way
+			while (groups && type == TK_PARENTHESIS_CLOSE) {
+				while (p_parser->operators[operators - 1].type != TK_PARENTHESIS_OPEN)
+					_expression_reduce(p_parser, &operands, &operators);
+				operators--;
+				groups--;
+				type = tokenizerAdvanceType(tk);
+			}
+			uint8_t power = binary_powers[type].left;
+			while (operators && p_parser->operators[operators - 1].power >= power
+					&& p_parser->operators[operators - 1].type != TK_PARENTHESIS_OPEN)
+				_expression_reduce(p_parser, &operands, &operators);
+			if (!power)
+				break;
+			p_parser->operators[operators++] = (PendingOperator){type, binary_powers[type].right, false};
+			tokenizerAdvance(tk);
+		}
+		if (groups)
+			ERR_EXPECTED_TERMINAL(TK_PARENTHESIS_CLOSE)
+		RET(p_parser->operands[0])
 	}
 
 	PROC(PROC_STATEMENT) {
-		RET(NULL)
+		CALL(PROC_EXPRESSION)
+		RET(POPPED)
+	}
+
+
+	default:
+		ERR_UNREACHABLE()
 	}
 
 	#undef PROC
 	#undef ctx
 	#undef CALL
+	#undef _CALL
+	#undef RETURN
 	#undef RET
-	return 1;
+	#undef POPPED
 }
 
-#if 0
 
-int parserParse(Parser *p_parser) {
-	for (ParseCtx *ctx = _stack_push(p_parser, _create_ctx(PROC_UNIT)); ctx; ctx = p_parser->stack_top) {
-		switch (ctx->type) {
-			case PROC_UNIT:
-				switch (ctx->state) {
-					case 0:
-						ctx->state++;
-						unit_get_declaration:
-						_stack_push(p_parser, _create_ctx(PROC_DECLARATION));
-						continue;
-					case 1:
-						if (p_parser->stack_popped) {
-							goto unit_get_declaration;
-						}
-						break;
-				}
-				if (tokenizerGetCurrentType(p_parser->tokenizer) != TK_EOF)
-					ERR_EXPECTED_NON_TERMINAL("DECLARATION")
-				_stack_pop(p_parser);
-				continue;
-			case PROC_DECLARATION:
-				proc_declaration:
-				switch (ctx->state) {
-					case 0:
-						_stack_push(p_parser, _create_ctx(PROC_LET_DECLARATION));
-						ctx->state++;
-						continue;
-					case 2:
-						_stack_push(p_parser, _create_ctx(PROC_METHOD_DECLARATION));
-						ctx->state++;
-						continue;
-					case 4:
-						break;
-					default:
-						if (p_parser->stack_popped) {
-							_stack_pop(p_parser);
-							continue;
-						}
-						ctx->state++;
-						goto proc_declaration;
-				}
-				_stack_pop_then_free(p_parser);
-				continue;
-			case PROC_SPACE_DECLARATION:
-				switch (ctx->state) {
-					case 0:
-						if (tokenizerGetCurrentType(p_parser->tokenizer) != TK_SPACE) {
-							_stack_pop_then_free(p_parser);
-							continue;
-						}
-						// if (tokenizerAdvanceType(p_parser->tokenizer) != TK_IDENTIFIER)
-						// 	ERR_EXPECTED_TERMINAL(TK_IDENTIFIER);
-						if (tokenizerAdvanceType(p_parser->tokenizer) != TK_BRACE_OPEN)
-							ERR_EXPECTED_TERMINAL(TK_BRACE_OPEN)
-						tokenizerAdvance(p_parser->tokenizer);
-						ctx->state = 1;
-					space_get_declaration:
-						_stack_push(p_parser, _create_ctx(PROC_DECLARATION));
-						continue;
-					default:
-						if (p_parser->stack_popped) {
-							goto space_get_declaration;
-						}
-				}
-				if (tokenizerGetCurrentType(p_parser->tokenizer) != TK_BRACE_CLOSE)
-					ERR_EXPECTED_TERMINAL(TK_BRACE_CLOSE);
-				tokenizerAdvance(p_parser->tokenizer);
-				_stack_pop(p_parser);
-				continue;
-			case PROC_ENUM_DECLARATION:
-				if (tokenizerGetCurrentType(p_parser->tokenizer) != TK_ENUM) {
-					_stack_pop_then_free(p_parser);
-					continue;
-				}
-				// if (tokenizerAdvanceType(p_parser->tokenizer) != TK_IDENTIFIER)
-				//	ERR_EXPECTED_TERMINAL(TK_IDENTIFIER)
-				if (tokenizerAdvanceType(p_parser->tokenizer) != TK_BRACE_OPEN)
-					ERR_EXPECTED_TERMINAL(TK_BRACE_OPEN)
-				while (tokenizerAdvanceType(p_parser->tokenizer) == TK_IDENTIFIER) {
-					if (tokenizerAdvanceType(p_parser->tokenizer) == TK_PARENTHESIS_OPEN) {
-						if (tokenizerAdvanceType(p_parser->tokenizer) == TK_IDENTIFIER)
-						if (tokenizerAdvanceType(p_parser->tokenizer) == TK_PARENTHESIS_CLOSE)
-							tokenizerAdvance(p_parser->tokenizer);
-						else ERR_EXPECTED_TERMINAL(TK_PARENTHESIS_CLOSE)
-						else ERR_EXPECTED_TERMINAL(TK_IDENTIFIER)
-					}
-					if (tokenizerGetCurrentType(p_parser->tokenizer) == TK_COMMA)
-						continue;
-					break;
-				}
-				if (tokenizerGetCurrentType(p_parser->tokenizer) != TK_BRACE_CLOSE)
-					ERR_EXPECTED_TERMINAL(TK_BRACE_CLOSE)
-				tokenizerAdvance(p_parser->tokenizer);
-				_stack_pop(p_parser);
-				continue;
-			case PROC_TYPE_DECLARATION:
-				switch (ctx->state) {
-					case 0:
-						if (tokenizerGetCurrentType(p_parser->tokenizer) != TK_TYPE) {
-							_stack_pop_then_free(p_parser);
-							continue;
-						}
-						// if (tokenizerAdvanceType(p_parser->tokenizer) != TK_IDENTIFIER)
-						//	ERR_EXPECTED_TERMINAL(TK_IDENTIFIER);
-						if (tokenizerAdvanceType(p_parser->tokenizer) != TK_BRACE_OPEN)
-							ERR_EXPECTED_TERMINAL(TK_BRACE_OPEN)
-						tokenizerAdvance(p_parser->tokenizer);
-						ctx->state = 1;
-					type_get_declaration:
-						_stack_push(p_parser, _create_ctx(PROC_LET_DECLARATION));
-						continue;
-					default:
-						if (p_parser->stack_popped) {
-							goto type_get_declaration;
-						}
-				}
-				if (tokenizerGetCurrentType(p_parser->tokenizer) != TK_BRACE_CLOSE)
-					ERR_EXPECTED_TERMINAL(TK_BRACE_CLOSE);
-				tokenizerAdvance(p_parser->tokenizer);
-				_stack_pop(p_parser);
-				continue;
-			case PROC_LET_DECLARATION:
-				switch (ctx->state) {
-					case 0:
-						if (tokenizerGetCurrentType(p_parser->tokenizer) != TK_LET) {
-							_stack_pop_then_free(p_parser);
-							continue;
-						}
-						if (tokenizerAdvanceType(p_parser->tokenizer) != TK_IDENTIFIER)
-							ERR_EXPECTED_TERMINAL(TK_IDENTIFIER)
-						if (tokenizerAdvanceType(p_parser->tokenizer) == TK_COLON) {
-							if (tokenizerAdvanceType(p_parser->tokenizer) == TK_CONST ||
-								tokenizerGetCurrentType(p_parser->tokenizer) == TK_STATIC) {
-								if (tokenizerAdvanceType(p_parser->tokenizer) != TK_IDENTIFIER)
-									ERR_EXPECTED_TERMINAL(TK_IDENTIFIER)
-							}
-							else if (tokenizerGetCurrentType(p_parser->tokenizer) != TK_IDENTIFIER)
-								ERR_EXPECTED_TERMINAL(TK_IDENTIFIER)
-							tokenizerAdvance(p_parser->tokenizer);
-						}
-						if (tokenizerGetCurrentType(p_parser->tokenizer) != TK_EQUAL) {
-							break;
-						}
-						ctx->state = 1;
-						if (tokenizerAdvanceType(p_parser->tokenizer) == TK_SPACE)
-							_stack_push(p_parser, _create_ctx(PROC_SPACE_DECLARATION));
-						else if (tokenizerGetCurrentType(p_parser->tokenizer) == TK_ENUM)
-							_stack_push(p_parser, _create_ctx(PROC_ENUM_DECLARATION));
-						else if (tokenizerGetCurrentType(p_parser->tokenizer) == TK_TYPE) {
-							_stack_push(p_parser, _create_ctx(PROC_TYPE_DECLARATION));
-						} else _stack_push(p_parser, _create_ctx(PROC_EXPRESSION));
-						continue;
-					default:
-						if (p_parser->stack_popped) {
-							break;
-						}
-						ERR_EXPECTED_NON_TERMINAL("EXPRESSION")
-				}
-				_stack_pop(p_parser);
-				continue;
-			case PROC_METHOD_DECLARATION:
-				switch (ctx->state) {
-					case 0:
-						if (tokenizerGetCurrentType(p_parser->tokenizer) != TK_FN) {
-							_stack_pop_then_free(p_parser);
-							continue;
-						}
-						if (tokenizerAdvanceType(p_parser->tokenizer) != TK_IDENTIFIER)
-							ERR_EXPECTED_TERMINAL(TK_IDENTIFIER)
-						if (tokenizerAdvanceType(p_parser->tokenizer) != TK_PARENTHESIS_OPEN)
-							ERR_EXPECTED_TERMINAL(TK_PARENTHESIS_OPEN);
-						if (tokenizerAdvanceType(p_parser->tokenizer) != TK_PARENTHESIS_CLOSE)
-							ERR_EXPECTED_TERMINAL(TK_PARENTHESIS_CLOSE)
-						if (tokenizerAdvanceType(p_parser->tokenizer) == TK_IDENTIFIER) {
-							// FIXME: implement fntion parameters
-							tokenizerAdvance(p_parser->tokenizer);
-						}
-						ctx->state = 1;
-						_stack_push(p_parser, _create_ctx(PROC_SCOPE));
-						continue;
-					case 1:
-						if (!p_parser->stack_popped)
-							ERR_EXPECTED_NON_TERMINAL("SCOPE")
-				}
-				_stack_pop(p_parser);
-				continue;
-			case PROC_SCOPE:
-				switch (ctx->state) {
-					case 0:
-						if (tokenizerGetCurrentType(p_parser->tokenizer) != TK_BRACE_OPEN) {
-							_stack_pop_then_free(p_parser);
-							continue;
-						}
-						tokenizerAdvance(p_parser->tokenizer);
-					scope_get_declaration:
-						ctx->state = 1;
-						_stack_push(p_parser, _create_ctx(PROC_DECLARATION));
-						continue;
-					case 2:
-						_stack_push(p_parser, _create_ctx(PROC_STATEMENT));
-						ctx->state++;
-						continue;
-					case 4:
-						break;
-					default:
-						if (p_parser->stack_popped) {
-							goto scope_get_declaration;
-						}
-						ctx->state++;
-						continue;
-				}
-				if (tokenizerGetCurrentType(p_parser->tokenizer) != TK_BRACE_CLOSE)
-					ERR_EXPECTED_TERMINAL(TK_BRACE_CLOSE)
-				tokenizerAdvance(p_parser->tokenizer);
-				_stack_pop(p_parser);
-				continue;
-			case PROC_STATEMENT:
-				switch (ctx->state) {
-					case 0:
-						switch (tokenizerGetCurrentType(p_parser->tokenizer)) {
-							case TK_IDENTIFIER:
-								if (tokenizerAdvanceType(p_parser->tokenizer) != TK_EQUAL)
-									ERR_EXPECTED_TERMINAL(TK_EQUAL)
-								tokenizerAdvance(p_parser->tokenizer);
-								_stack_push(p_parser, _create_ctx(PROC_EXPRESSION));
-								ctx->state = 1;
-								continue;
-							case TK_IF:
-								tokenizerAdvance(p_parser->tokenizer);
-								_stack_push(p_parser, _create_ctx(PROC_EXPRESSION));
-								ctx->state = 2;
-								continue;
-							case TK_MATCH:
-								tokenizerAdvance(p_parser->tokenizer);
-								_stack_push(p_parser, _create_ctx(PROC_EXPRESSION));
-								ctx->state = 4;
-								continue;
-							case TK_WHILE:
-								// FIXME: implement while statement
-							case TK_FOR:
-								// FIXME: implement for statement
-							case TK_RET:
-								// FIXME: implement return statement
-							case TK_BREAK:
-								// FIXME: implement break statement
-							case TK_CONTINUE:
-								// FIXME: implement continue statement
-							default:
-						}
-						break;
-					case 1:
-						if (p_parser->stack_popped) {
-							_stack_pop(p_parser);
-							continue;
-						}
-						ERR_EXPECTED_NON_TERMINAL("EXPRESSION")
-					case 2:
-						if (p_parser->stack_popped) {
-							_stack_push(p_parser, _create_ctx(PROC_SCOPE));
-							ctx->state = 3;
-							continue;
-						}
-						ERR_EXPECTED_NON_TERMINAL("EXPRESSION")
-					case 3:
-						if (p_parser->stack_popped) {
-							_stack_pop(p_parser);
-							continue;
-						}
-						ERR_EXPECTED_NON_TERMINAL("SCOPE")
-					case 4:
-						if (!p_parser->stack_popped)
-							ERR_EXPECTED_NON_TERMINAL("EXPRESSION")
-						if (tokenizerGetCurrentType(p_parser->tokenizer) != TK_BRACE_OPEN)
-							ERR_EXPECTED_TERMINAL(TK_BRACE_OPEN)
-						tokenizerAdvance(p_parser->tokenizer);
-						if (tokenizerGetCurrentType(p_parser->tokenizer) == TK_BRACE_CLOSE) {
-							tokenizerAdvance(p_parser->tokenizer);
-							_stack_pop(p_parser);
-							continue;
-						}
-					match_get_case:
-						if (tokenizerGetCurrentType(p_parser->tokenizer) == TK_UNDERSCORE) {
-							if (tokenizerAdvanceType(p_parser->tokenizer) != TK_FORWARD_ARROW)
-								ERR_EXPECTED_TERMINAL(TK_FORWARD_ARROW)
-							tokenizerAdvance(p_parser->tokenizer);
-							_stack_push(p_parser, _create_ctx(PROC_SCOPE));
-							ctx->state = 8;
-							continue;
-						}
-						_stack_push(p_parser, _create_ctx(PROC_EXPRESSION));
-						ctx->state = 5;
-						continue;
-					case 5:
-						if (!p_parser->stack_popped)
-							goto match_end;
-						__attribute__((fallthrough));
-					case 6:
-						if (!p_parser->stack_popped)
-							ERR_EXPECTED_NON_TERMINAL("EXPRESSION")
-						if (tokenizerGetCurrentType(p_parser->tokenizer) == TK_COMMA) {
-							tokenizerAdvance(p_parser->tokenizer);
-							_stack_push(p_parser, _create_ctx(PROC_EXPRESSION));
-							ctx->state = 6;
-							continue;
-						}
-						if (tokenizerGetCurrentType(p_parser->tokenizer) != TK_FORWARD_ARROW)
-							ERR_EXPECTED_TERMINAL(TK_FORWARD_ARROW)
-						tokenizerAdvance(p_parser->tokenizer);
-						_stack_push(p_parser, _create_ctx(PROC_SCOPE));
-						ctx->state = 7;
-						continue;
-					case 7:
-						if (!p_parser->stack_popped)
-							ERR_EXPECTED_NON_TERMINAL("SCOPE")
-						goto match_get_case;
-					case 8:
-						if (!p_parser->stack_popped)
-							ERR_EXPECTED_NON_TERMINAL("SCOPE")
-						__attribute__((fallthrough));
-					case 9:
-					match_end:
-						if (tokenizerGetCurrentType(p_parser->tokenizer) != TK_BRACE_CLOSE)
-							ERR_EXPECTED_TERMINAL(TK_BRACE_CLOSE)
-						tokenizerAdvance(p_parser->tokenizer);
-						_stack_pop(p_parser);
-						continue;
-				}
-				_stack_pop_then_free(p_parser);
-				continue;
-			case PROC_EXPRESSION:
-				// TODO: Use a regular Pratt parsing algorithem currently this is enough
-				switch (ctx->state) {
-					case 0:
-						ctx->state++;
-						expression_get_binary:
-						_stack_push(p_parser, _create_ctx(PROC_EXP_BINARY));
-						continue;
-					case 1:
-						if (p_parser->stack_popped) {
-							switch (tokenizerGetCurrentType(p_parser->tokenizer)) {
-								case TK_PLUS:
-								case TK_MINUS:
-									tokenizerAdvance(p_parser->tokenizer);
-									goto expression_get_binary;
-								default:
-									break;
-							}
-							break;
-						}
-						_stack_pop_then_free(p_parser);
-						continue;
-					case 2:
-						if (p_parser->stack_popped) {
-							break;
-						}
-						ERR_EXPECTED_NON_TERMINAL("EXPRESSION")
-				}
-				_stack_pop(p_parser);
-				continue;
-			case PROC_EXP_BINARY:
-				switch (ctx->state) {
-					case 0:
-						if (tokenizerGetCurrentType(p_parser->tokenizer) == TK_MINUS
-						|| tokenizerGetCurrentType(p_parser->tokenizer) == TK_BANG) {
-							tokenizerAdvance(p_parser->tokenizer);
-						}
-						_stack_push(p_parser, _create_ctx(PROC_EXP_VALUE));
-						ctx->state++;
-						continue;
-					case 1:
-						if (p_parser->stack_popped) {
-							switch (tokenizerGetCurrentType(p_parser->tokenizer)) {
-								case TK_STAR:
-								case TK_SLASH:
-									tokenizerAdvance(p_parser->tokenizer);
-									_stack_push(p_parser, _create_ctx(PROC_EXP_BINARY));
-									ctx->state++;
-									continue;
-								default:
-									break;
-							}
-							break;
-						}
-						_stack_pop_then_free(p_parser);
-						continue;
-					case 2:
-						if (p_parser->stack_popped) {
-							break;
-						}
-						ERR_EXPECTED_NON_TERMINAL("EXPRESSION")
-				}
-				_stack_pop(p_parser);
-				continue;
-			case PROC_EXP_VALUE:
-				switch (ctx->state) {
-					case 0:
-						if (tokenizerGetCurrentType(p_parser->tokenizer) == TK_LITERAL) {
-							tokenizerAdvance(p_parser->tokenizer);
-							break;
-						}
-						if (tokenizerGetCurrentType(p_parser->tokenizer) == TK_IDENTIFIER) {
-							tokenizerAdvance(p_parser->tokenizer);
-							break;
-						}
-						if (tokenizerGetCurrentType(p_parser->tokenizer) != TK_PARENTHESIS_OPEN) {
-							_stack_pop_then_free(p_parser);
-							continue;
-						}
-						tokenizerAdvance(p_parser->tokenizer);
-						_stack_push(p_parser, _create_ctx(PROC_EXPRESSION));
-						ctx->state++;
-						continue;
-					case 1:
-						if (p_parser->stack_popped) {
-							if (tokenizerGetCurrentType(p_parser->tokenizer) != TK_PARENTHESIS_CLOSE)
-								ERR_EXPECTED_TERMINAL(TK_PARENTHESIS_CLOSE)
-							tokenizerAdvance(p_parser->tokenizer);
-							break;
-						}
-						ERR_EXPECTED_NON_TERMINAL("EXPRESSION")
-				}
-				_stack_pop(p_parser);
-				continue;
-			default:
-				ERR_UNREACHABLE()
-		}
+/*
+ * _run while tracing: one event for the whole parse and the time of each
+ * family of procedures added to the totals. Every dispatch still reads the
+ * clock (_time_switch), only recording an event per frame is avoided.
+*/
+static int _run_timed(Parser *p_parser, ProcType p_entry) {
+	uint64_t start = traceBegin();
+	memset(p_parser->proc_time, 0, sizeof(p_parser->proc_time));
+	memset(p_parser->proc_calls, 0, sizeof(p_parser->proc_calls));
+	p_parser->timed = true;
+	p_parser->timed_proc = PROC_UNIT;
+	p_parser->timed_since = start;
+	int status = _run(p_parser, p_entry);
+	p_parser->proc_time[p_parser->timed_proc] += traceNow() - p_parser->timed_since;
+	p_parser->timed = false;
+	for (int i = 0; i < PROC_COUNT; i++)
+		traceTotal(proc_names[i], p_parser->proc_time[i], p_parser->proc_calls[i]);
+
+	char detail[TRACE_DETAIL_SIZE];
+	const char *source = tokenizerGetSource(p_parser->tokenizer);
+	snprintf(detail, sizeof(detail), "%s, depth %d", source ? source : "", p_parser->max_depth + 1);
+	traceEnd(p_entry == PROC_SCOPE ? "Parse body" : p_entry == PROC_LET ? "Parse declaration" : "Parse", detail, start);
+	return status;
+}
+
+
+static int _parse(Parser *p_parser, ProcType p_entry) {
+	int status = traceOn ? _run_timed(p_parser, p_entry) : _run(p_parser, p_entry);
+	STATS_MAX(STAT_MAX_DEPTH, p_parser->max_depth + 1);
+	return status;
+}
+
+
+/*
+ * Top level declarations shared out between threads, every piece of text is
+ * parsed on its own into a space of its own.
+*/
+typedef struct {
+	const Parser *unit;
+	const uint32_t *offsets;
+	const int *lines;
+	size_t count;
+	Node **spaces;
+	atomic_size_t next;
+	atomic_bool failed;
+} PieceWork;
+
+
+typedef struct {
+	PieceWork *work;
+	Arena *arena;
+	pthread_t thread;
+	bool started;
+} PieceWorker;
+
+
+static void *_parse_pieces_worker(void *p_ctx) {
+	PieceWorker *worker = (PieceWorker*)p_ctx;
+	PieceWork *work = worker->work;
+	size_t size;
+	const char *text = tokenizerGetBuffer(work->unit->tokenizer, &size);
+	const char *source = tokenizerGetSource(work->unit->tokenizer);
+	size_t i;
+	while (!atomic_load_explicit(&work->failed, memory_order_relaxed) &&
+			(i = atomic_fetch_add_explicit(&work->next, 1, memory_order_relaxed)) < work->count) {
+		// A piece ends where the next one starts, its tokenizer sees EOF there
+		size_t end = i + 1 < work->count ? work->offsets[i + 1] : size;
+		Tokenizer *tk = tokenizerInitBuffer(text, end, source);
+		if (!tk)
+			abort();
+		tokenizerStartAt(tk, work->offsets[i], work->lines[i]);
+		Parser *piece = _create_parser(tk, worker->arena);
+		piece->quiet = true;
+		piece->lazy_bodies = work->unit->lazy_bodies;
+		piece->bodies = work->unit->bodies;
+		if (_parse(piece, PROC_SPACE))
+			atomic_store_explicit(&work->failed, true, memory_order_relaxed);
+		else
+			work->spaces[i] = piece->root;
+		parserTerminate(piece);
+		tokenizerTerminate(tk);
 	}
+	return NULL;
+}
+
+
+/*
+ * Cuts the text at top level lets, parses the pieces on p_parser->threads
+ * threads each with an arena of its own, then links their declarations in
+ * order under one space. Returns false when the text was not cut or a piece
+ * failed, nothing is kept then and the text is parsed again in one go so
+ * errors come out as they always did.
+*/
+static bool _parse_pieces(Parser *p_parser) {
+	size_t size;
+	if (!tokenizerGetBuffer(p_parser->tokenizer, &size))
+		return false;
+	size_t max = (size_t)p_parser->threads * PIECES_PER_THREAD;
+	if (max > size / MIN_PIECE_SIZE)
+		max = size / MIN_PIECE_SIZE;
+	if (max < 2)
+		return false;
+	uint32_t *offsets = (uint32_t*)malloc(max * sizeof(uint32_t));
+	int *lines = (int*)malloc(max * sizeof(int));
+	Node **spaces = (Node**)malloc(max * sizeof(Node*));
+	if (!offsets || !lines || !spaces)
+		abort();
+	PieceWork work = {
+		.unit = p_parser,
+		.offsets = offsets,
+		.lines = lines,
+		.count = tokenizerSplit(p_parser->tokenizer, max, offsets, lines),
+		.spaces = spaces,
+	};
+	atomic_init(&work.next, 0);
+	atomic_init(&work.failed, false);
+	bool parsed = false;
+	if (work.count < 2)
+		goto done;
+	uint64_t start = traceBegin();
+
+	int threads = (size_t)p_parser->threads < work.count ? p_parser->threads : (int)work.count;
+	PieceWorker *workers = (PieceWorker*)malloc(threads * sizeof(PieceWorker));
+	if (!workers)
+		abort();
+	// The calling thread is the first worker, one that fails to start leaves its share to the others
+	for (int i = 0; i < threads; i++) {
+		workers[i] = (PieceWorker){.work = &work, .arena = arenaInit(0), .started = false};
+		if (!workers[i].arena)
+			abort();
+		if (i)
+			workers[i].started = !pthread_create(&workers[i].thread, NULL, _parse_pieces_worker, &workers[i]);
+	}
+	_parse_pieces_worker(&workers[0]);
+	for (int i = 0; i < threads; i++) {
+		if (workers[i].started)
+			pthread_join(workers[i].thread, NULL);
+		arenaAdopt(p_parser->arena, workers[i].arena);
+	}
+	free(workers);
+
+	if (atomic_load(&work.failed)) {
+		arenaReset(p_parser->arena);
+		goto done;
+	}
+	for (size_t i = 1; i < work.count; i++)
+		nodeSpaceAppend(spaces[0], spaces[i]);
+	p_parser->root = spaces[0];
+	parsed = true;
+	traceEnd("Parse pieces", tokenizerGetSource(p_parser->tokenizer), start);
+
+	done:
+	free(offsets);
+	free(lines);
+	free(spaces);
+	return parsed;
+}
+
+
+int parserParse(Parser *p_parser) {
+	if (p_parser->owns_arena)
+		arenaReset(p_parser->arena);
+	p_parser->body_errors = 0;
+	if (p_parser->threads > 1 && p_parser->owns_arena && _parse_pieces(p_parser))
+		return 0;
+	return _parse(p_parser, PROC_SPACE);
+}
+
+
+/*
+ * Parses only the top level declaration at the current token, the root is
+ * then its let. Past the last one the root is NULL, and anything but the end
+ * of the text is the error parserParse would report there.
+*/
+int parserParseDeclaration(Parser *p_parser) {
+	if (tokenizerGetCurrentType(p_parser->tokenizer) == TK_LET)
+		return _parse(p_parser, PROC_LET);
+	if (_parse(p_parser, PROC_SPACE))
+		return -1;
+	p_parser->root = NULL;
 	return 0;
 }
-#endif
+
+
+Node *parserGetRoot(const Parser *p_parser) {
+	return p_parser->root;
+}
+
+
+/*
+ * How many skipped bodies failed to parse. They are parsed as the tree is
+ * walked, after parserParse returned, so the count is only final once it
+ * was (nodeFlatten). A tree with any is missing their scopes.
+*/
+size_t parserGetBodyErrors(const Parser *p_parser) {
+	return p_parser->body_errors;
+}
+
+
+Arena *parserGetArena(const Parser *p_parser) {
+	return p_parser->arena;
+}
+
 
 void parserTerminate(Parser *p_parser) {
+	if (p_parser->owns_arena)
+		arenaTerminate(p_parser->arena);
+	free(p_parser->frames);
+	free(p_parser->operands);
+	free(p_parser->operators);
 	free(p_parser);
 }
 
@@ -2,12 +2,21 @@
 #define PARSER_H
 
 #include "tokenizer.h"
+#include "../syntax_tree/syntax_tree.h"
 
 typedef struct Parser Parser;
 
 
 Parser* parserInit(Tokenizer *p_tokenizer);
+Parser *parserInitArena(Tokenizer *p_tokenizer, Arena *p_arena);
+void parserSetLazyBodies(Parser *p_parser, bool p_lazy);
+void parserSetThreads(Parser *p_parser, int p_threads);
+void parserSetQuiet(Parser *p_parser, bool p_quiet);
 int parserParse(Parser *p_parser);
+int parserParseDeclaration(Parser *p_parser);
+Node *parserGetRoot(const Parser *p_parser);
+size_t parserGetBodyErrors(const Parser *p_parser);
+Arena *parserGetArena(const Parser *p_parser);
 void parserTerminate(Parser *p_parser);
 
 
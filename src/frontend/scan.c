@@ -0,0 +1,224 @@
+#include "scan.h"
+
+#include <stdint.h>
+#include <string.h>
+
+#if defined(__x86_64__) || (defined(__i386__) && defined(__SSE2__))
+#define SCAN_X86
+#include <immintrin.h>
+#endif
+
+
+typedef const char *(*BlankFn)(const char *, const char *, int *);
+typedef const char *(*RunFn)(const char *, const char *);
+
+
+/*
+ * Scalar kernels, used for tails and on targets without SIMD
+*/
+
+
+static inline int _is_blank(char p_char) {
+	return p_char == ' ' || p_char == '\t' || p_char == '\n';
+}
+
+
+static inline int _is_ident(char p_char) {
+	return  (p_char >= 'a' && p_char <= 'z') ||
+			(p_char >= 'A' && p_char <= 'Z') ||
+			(p_char >= '0' && p_char <= '9') ||
+			p_char == '_';
+}
+
+
+static const char *_skip_blank_scalar(const char *p, const char *p_end, int *p_newlines) {
+	for (; p < p_end && _is_blank(*p); p++)
+		*p_newlines += *p == '\n';
+	return p;
+}
+
+
+static const char *_identifier_scalar(const char *p, const char *p_end) {
+	while (p < p_end && _is_ident(*p))
+		p++;
+	return p;
+}
+
+
+static const char *_digits_scalar(const char *p, const char *p_end) {
+	while (p < p_end && *p >= '0' && *p <= '9')
+		p++;
+	return p;
+}
+
+
+#ifdef SCAN_X86
+
+
+/*
+ * SSE2 kernels, 16 bytes per step
+*/
+
+
+#define SSE_RANGE(V, LO, HI) _mm_and_si128(\
+	_mm_cmpgt_epi8(V, _mm_set1_epi8((LO) - 1)),\
+	_mm_cmplt_epi8(V, _mm_set1_epi8((HI) + 1)))
+
+
+static const char *_skip_blank_sse2(const char *p, const char *p_end, int *p_newlines) {
+	const __m128i space = _mm_set1_epi8(' ');
+	const __m128i tab = _mm_set1_epi8('\t');
+	const __m128i newline = _mm_set1_epi8('\n');
+	for (; p_end - p >= 16; p += 16) {
+		__m128i v = _mm_loadu_si128((const __m128i*)p);
+		__m128i nl = _mm_cmpeq_epi8(v, newline);
+		__m128i blank = _mm_or_si128(nl, _mm_or_si128(
+				_mm_cmpeq_epi8(v, space), _mm_cmpeq_epi8(v, tab)));
+		uint32_t stop = ~(uint32_t)_mm_movemask_epi8(blank) & 0xFFFF;
+		uint32_t lines = (uint32_t)_mm_movemask_epi8(nl);
+		if (stop) {
+			int at = __builtin_ctz(stop);
+			*p_newlines += __builtin_popcount(lines & ((1u << at) - 1));
+			return p + at;
+		}
+		*p_newlines += __builtin_popcount(lines);
+	}
+	return _skip_blank_scalar(p, p_end, p_newlines);
+}
+
+
+static inline __m128i _ident_mask_sse2(__m128i p_v) {
+	__m128i lower = _mm_or_si128(p_v, _mm_set1_epi8(0x20));
+	return _mm_or_si128(
+		_mm_or_si128(SSE_RANGE(lower, 'a', 'z'), SSE_RANGE(p_v, '0', '9')),
+		_mm_cmpeq_epi8(p_v, _mm_set1_epi8('_')));
+}
+
+
+static const char *_identifier_sse2(const char *p, const char *p_end) {
+	for (; p_end - p >= 16; p += 16) {
+		__m128i v = _mm_loadu_si128((const __m128i*)p);
+		uint32_t stop = ~(uint32_t)_mm_movemask_epi8(_ident_mask_sse2(v)) & 0xFFFF;
+		if (stop)
+			return p + __builtin_ctz(stop);
+	}
+	return _identifier_scalar(p, p_end);
+}
+
+
+static const char *_digits_sse2(const char *p, const char *p_end) {
+	for (; p_end - p >= 16; p += 16) {
+		__m128i v = _mm_loadu_si128((const __m128i*)p);
+		uint32_t stop = ~(uint32_t)_mm_movemask_epi8(SSE_RANGE(v, '0', '9')) & 0xFFFF;
+		if (stop)
+			return p + __builtin_ctz(stop);
+	}
+	return _digits_scalar(p, p_end);
+}
+
+
+/*
+ * AVX2 kernels, 32 bytes per step
+*/
+
+
+#define AVX_RANGE(V, LO, HI) _mm256_and_si256(\
+	_mm256_cmpgt_epi8(V, _mm256_set1_epi8((LO) - 1)),\
+	_mm256_cmpgt_epi8(_mm256_set1_epi8((HI) + 1), V))
+
+
+__attribute__((target("avx2")))
+static const char *_skip_blank_avx2(const char *p, const char *p_end, int *p_newlines) {
+	const __m256i space = _mm256_set1_epi8(' ');
+	const __m256i tab = _mm256_set1_epi8('\t');
+	const __m256i newline = _mm256_set1_epi8('\n');
+	for (; p_end - p >= 32; p += 32) {
+		__m256i v = _mm256_loadu_si256((const __m256i*)p);
+		__m256i nl = _mm256_cmpeq_epi8(v, newline);
+		__m256i blank = _mm256_or_si256(nl, _mm256_or_si256(
+				_mm256_cmpeq_epi8(v, space), _mm256_cmpeq_epi8(v, tab)));
+		uint32_t stop = ~(uint32_t)_mm256_movemask_epi8(blank);
+		uint32_t lines = (uint32_t)_mm256_movemask_epi8(nl);
+		if (stop) {
+			int at = __builtin_ctz(stop);
+			*p_newlines += __builtin_popcount(lines & ((1u << at) - 1));
+			return p + at;
+		}
+		*p_newlines += __builtin_popcount(lines);
+	}
+	return _skip_blank_sse2(p, p_end, p_newlines);
+}
+
+
+__attribute__((target("avx2")))
+static const char *_identifier_avx2(const char *p, const char *p_end) {
+	for (; p_end - p >= 32; p += 32) {
+		__m256i v = _mm256_loadu_si256((const __m256i*)p);
+		__m256i lower = _mm256_or_si256(v, _mm256_set1_epi8(0x20));
+		__m256i ident = _mm256_or_si256(
+			_mm256_or_si256(AVX_RANGE(lower, 'a', 'z'), AVX_RANGE(v, '0', '9')),
+			_mm256_cmpeq_epi8(v, _mm256_set1_epi8('_')));
+		uint32_t stop = ~(uint32_t)_mm256_movemask_epi8(ident);
+		if (stop)
+			return p + __builtin_ctz(stop);
+	}
+	return _identifier_sse2(p, p_end);
+}
+
+
+__attribute__((target("avx2")))
+static const char *_digits_avx2(const char *p, const char *p_end) {
+	for (; p_end - p >= 32; p += 32) {
+		__m256i v = _mm256_loadu_si256((const __m256i*)p);
+		uint32_t stop = ~(uint32_t)_mm256_movemask_epi8(AVX_RANGE(v, '0', '9'));
+		if (stop)
+			return p + __builtin_ctz(stop);
+	}
+	return _digits_sse2(p, p_end);
+}
+
+
+static BlankFn skip_blank_impl = _skip_blank_sse2;
+static RunFn identifier_impl = _identifier_sse2;
+static RunFn digits_impl = _digits_sse2;
+
+
+__attribute__((constructor))
+static void _select_kernels(void) {
+	__builtin_cpu_init();
+	if (__builtin_cpu_supports("avx2")) {
+		skip_blank_impl = _skip_blank_avx2;
+		identifier_impl = _identifier_avx2;
+		digits_impl = _digits_avx2;
+	}
+}
+
+#else
+
+static BlankFn skip_blank_impl = _skip_blank_scalar;
+static RunFn identifier_impl = _identifier_scalar;
+static RunFn digits_impl = _digits_scalar;
+
+#endif // SCAN_X86
+
+
+const char *scanSkipBlank(const char *p_begin, const char *p_end, int *p_newlines) {
+	return skip_blank_impl(p_begin, p_end, p_newlines);
+}
+
+
+const char *scanFindNewline(const char *p_begin, const char *p_end) {
+	// libc's memchr is already vectorized and dispatched per CPU
+	const char *nl = memchr(p_begin, '\n', p_end - p_begin);
+	return nl ? nl : p_end;
+}
+
+
+const char *scanIdentifier(const char *p_begin, const char *p_end) {
+	return identifier_impl(p_begin, p_end);
+}
+
+
+const char *scanDigits(const char *p_begin, const char *p_end) {
+	return digits_impl(p_begin, p_end);
+}
@@ -0,0 +1,15 @@
+#ifndef SCAN_H
+#define SCAN_H
+
+/*
+ * Vectorized scanning kernels used by the tokenizer. Every kernel scans the
+ * range [p_begin, p_end) and returns a pointer to the first byte that does not
+ * belong to the run (p_end if the whole range does).
+*/
+
+const char *scanSkipBlank(const char *p_begin, const char *p_end, int *p_newlines);
+const char *scanFindNewline(const char *p_begin, const char *p_end);
+const char *scanIdentifier(const char *p_begin, const char *p_end);
+const char *scanDigits(const char *p_begin, const char *p_end);
+
+#endif // SCAN_H
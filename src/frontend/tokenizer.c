@@ -1,34 +1,156 @@
+#define _POSIX_C_SOURCE 200809L
 #include "tokenizer.h"
+#include "scan.h"
+#include "keywords.h"
+#include "../extra/interner.h"
+#include "../extra/stats.h"
+#include "../extra/trace.h"
 
 
 #include <stdlib.h>
 #include <stdbool.h>
+#include <stdint.h>
 #include <string.h>
+#include <math.h>
+#include <assert.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <pthread.h>
+#include <stdatomic.h>
 
 
-#define MAX_KEYWORD_LENGTH 10
-#define MIN_KEYWORD_LENGTH 2
 #define MAX_IDENTIFIER_LENGTH 64
+// Longer literals than this are copied to the heap for strtod
 #define MAX_NUMBER_LENGTH 128
+#define MAX_EXPONENT 100000
+#define STREAM_CHUNK_SIZE 4096
+// Token offsets and counts are 32 bits, larger inputs are refused
+#define MAX_INPUT_SIZE ((size_t)UINT32_MAX)
+#define NO_TOKEN UINT32_MAX
+#define TOKEN_RING_SIZE 64
+#define WHOLE_FILE UINT32_MAX
+// Type, offset, length, line and payload of a stored token
+#define TOKEN_SLOT_SIZE (sizeof(uint8_t) + 4 * sizeof(uint32_t))
+// Tokens handed from the lexer thread at once, and batches in flight
+#define PIPE_BATCH_SIZE 256
+#define PIPE_DEPTH 16
+// Checks of the other side before going to sleep on the condition
+#define PIPE_SPINS 256
 
 
 struct Token {
 	TokenType type;
 	void* data;
 	int line;
+	uint32_t offset;
+	uint32_t length;
+	uint32_t symbol;
+	const char *text;
 	const char *source;
 };
 
 
+/*
+ * Token storage, one parallel array per field. Token i lives in slot i & mask:
+ * streams keep a ring of the latest tokens that grows only when lookahead or a
+ * mark needs more, LexAll keeps the whole file (mask of all ones).
+ * The payload is the symbol id of identifiers, the error code of errors and
+ * for literals an index into the literal pool (0 means none). A ring has one
+ * pool entry per slot, at slot + 1.
+*/
+typedef struct {
+	uint8_t *types;
+	uint32_t *offsets;
+	uint32_t *lengths;
+	uint32_t *lines;
+	uint32_t *payloads;
+	uint32_t count;
+	uint32_t capacity;
+	uint32_t mask;
+	Literal *pool;
+	uint32_t pool_count;
+	uint32_t pool_capacity;
+} TokenArray;
+
+
+typedef enum {
+	INPUT_BUFFER, // Borrowed from the caller
+	INPUT_MAPPED, // mmap'ed file
+	INPUT_HEAP, // File slurped into an owned block
+	INPUT_STREAM, // Pulled through the callback on demand
+} InputType;
+
+
+/*
+ * Stream input is accumulated in a growing block, old blocks are kept alive
+ * until termination so pointers into already read text never dangle.
+*/
+typedef struct StreamBlock StreamBlock;
+struct StreamBlock {
+	StreamBlock *prev;
+	size_t capacity;
+	char data[];
+};
+
+
+typedef struct {
+	uint32_t count;
+	Token tokens[PIPE_BATCH_SIZE];
+	// Literal tokens point here, the lexer reuses its own slot
+	Literal literals[PIPE_BATCH_SIZE];
+} PipeBatch;
+
+
+/*
+ * Single producer, single consumer ring of token batches between a lexer
+ * thread and the parser. Each side only writes its own counter, a side that
+ * finds nothing to do spins a little then sleeps until the other wakes it.
+*/
+typedef struct {
+	// Owns the stream, only ever touched by the lexer thread
+	Tokenizer *lexer;
+	pthread_t thread;
+	_Alignas(64) atomic_uint published;
+	_Alignas(64) atomic_uint released;
+	// Tokens the parser took from the batch at released
+	uint32_t read;
+	atomic_bool closed;
+	atomic_int sleepers;
+	pthread_mutex_t lock;
+	pthread_cond_t wake;
+	PipeBatch batches[PIPE_DEPTH];
+} TokenPipe;
+
+
 struct Tokenizer {
+	InputType input;
+	const char *data;
+	size_t size;
+	size_t pos;
+	bool is_eof;
+	// A stream that went on past MAX_INPUT_SIZE, cut there
+	bool too_large;
+	size_t mapped_size;
+	StreamBlock *stream;
 	TkGetCharCallback get_char_callback;
 	void* callback_bind_ctx;
-	Token *current_tk;
-	bool tk_should_be_free;
-	char last_char;
-	bool is_char_consumed;
+	Interner *interner;
+	Token lexed;
+	Literal literal;
+	Token token;
+	size_t token_start;
+	TokenArray tokens;
+	uint32_t cursor;
+	uint32_t view;
+	uint32_t *marks;
+	uint32_t mark_count;
+	uint32_t mark_capacity;
 	int line;
 	const char *source;
+	TokenPipe *pipe;
 };
 
 
@@ -38,16 +160,21 @@ enum {
 	UNRECOGNIZABLE,
 	IDENTIFIER_TOO_LONG,
 	INVALID_NUMBER,
+	NUMBER_OUT_OF_RANGE,
 	UNTERMINATED_STRING,
+	INPUT_TOO_LARGE,
 };
 static const char *errors[] = {
 	"Unreachable",
 	"Unrecognizable",
 	"Identifier too long",
 	"Invalid number",
+	"Number out of range",
 	"Unterminated string",
+	"Input over 4 GiB",
 };
-#define ERR(E) (errors[E])
+// Error tokens point at their table entry, the index is the error code
+#define ERR(E) (&errors[E])
 
 
 static const char *token_names[] = {
@@ -173,21 +300,66 @@ static const char *token_names[] = {
 */
 
 
-static void _advance(Tokenizer *p_tokenizer) {
-	p_tokenizer->last_char = p_tokenizer->get_char_callback(p_tokenizer->callback_bind_ctx);
-	p_tokenizer->is_char_consumed = false;
+static bool _stream_reserve(Tokenizer *p_tokenizer, size_t p_size) {
+	StreamBlock *old = p_tokenizer->stream;
+	if (old && old->capacity >= p_size)
+		return true;
+	size_t capacity = old ? old->capacity : STREAM_CHUNK_SIZE;
+	while (capacity < p_size)
+		capacity *= 2;
+	StreamBlock *block = (StreamBlock*)malloc(sizeof(StreamBlock) + capacity);
+	if (!block)
+		return false;
+	block->prev = old;
+	block->capacity = capacity;
+	if (old)
+		memcpy(block->data, old->data, p_tokenizer->size);
+	p_tokenizer->stream = block;
+	p_tokenizer->data = block->data;
+	return true;
+}
+
+
+static char _underflow(Tokenizer *p_tokenizer) {
+	if (p_tokenizer->is_eof || p_tokenizer->input != INPUT_STREAM)
+		return -1;
+	if (!_stream_reserve(p_tokenizer, p_tokenizer->size + STREAM_CHUNK_SIZE)) {
+		p_tokenizer->is_eof = true;
+		return -1;
+	}
+	char *dst = p_tokenizer->stream->data;
+	size_t size = p_tokenizer->size;
+	size_t end = size + STREAM_CHUNK_SIZE < MAX_INPUT_SIZE ? size + STREAM_CHUNK_SIZE : MAX_INPUT_SIZE;
+	for (; size < end; size++) {
+		char c = p_tokenizer->get_char_callback(p_tokenizer->callback_bind_ctx);
+		if (c == -1) {
+			p_tokenizer->is_eof = true;
+			break;
+		}
+		dst[size] = c;
+	}
+	// Full up, anything more is the error _lex returns in place of EOF
+	if (size == MAX_INPUT_SIZE && !p_tokenizer->is_eof) {
+		p_tokenizer->is_eof = true;
+		p_tokenizer->too_large = p_tokenizer->get_char_callback(p_tokenizer->callback_bind_ctx) != -1;
+	}
+	STATS_ADD(STAT_BYTES_READ, size - p_tokenizer->size);
+	p_tokenizer->size = size;
+	if (p_tokenizer->pos < size)
+		return p_tokenizer->data[p_tokenizer->pos];
+	return -1;
 }
 
 
-static void _consume(Tokenizer *p_tokenizer) {
-	p_tokenizer->is_char_consumed = true;
+static inline void _consume(Tokenizer *p_tokenizer) {
+	p_tokenizer->pos++;
 }
 
 
-static char _get_current_char(Tokenizer *p_tokenizer) {
-	if (p_tokenizer->is_char_consumed)
-		_advance(p_tokenizer);
-	return p_tokenizer->last_char;
+static inline char _get_current_char(Tokenizer *p_tokenizer) {
+	if (p_tokenizer->pos < p_tokenizer->size)
+		return p_tokenizer->data[p_tokenizer->pos];
+	return _underflow(p_tokenizer);
 }
 
 
@@ -207,8 +379,25 @@ static bool _is_alpha(char p_char) {
 }
 
 
-static inline bool _is_alphanum(char p_char) {
-	return _is_digit(p_char) || _is_alpha(p_char);
+/*
+ * Runs the scan kernel over the buffered input, pulling more of the stream in
+ * whenever the run reaches the end of what has been read so far.
+*/
+static void _skip_run(Tokenizer *p_tokenizer, const char *(*p_scan)(const char*, const char*)) {
+	do {
+		const char *data = p_tokenizer->data;
+		p_tokenizer->pos = p_scan(data + p_tokenizer->pos, data + p_tokenizer->size) - data;
+	} while (p_tokenizer->pos == p_tokenizer->size && _underflow(p_tokenizer) != -1);
+}
+
+
+static void _skip_blank(Tokenizer *p_tokenizer) {
+	do {
+		const char *data = p_tokenizer->data;
+		int lines = 0;
+		p_tokenizer->pos = scanSkipBlank(data + p_tokenizer->pos, data + p_tokenizer->size, &lines) - data;
+		p_tokenizer->line += lines;
+	} while (p_tokenizer->pos == p_tokenizer->size && _underflow(p_tokenizer) != -1);
 }
 
 
@@ -217,254 +406,639 @@ static inline bool _is_alphanum(char p_char) {
 */
 
 
-static void _free_token(Token *p_token) {
+static void _free_token_data(Token *p_token) {
+	if (p_token->type == TK_LITERAL && p_token->data)
+		literalRelease((Literal*)p_token->data);
+}
+
+
+static Token *_create_token(Tokenizer *p_tokenizer, TokenType p_type, void *p_data) {
+	STATS_ADD(STAT_TOKENS, 1);
+	Token *tk = &p_tokenizer->lexed;
+	*tk = (Token){
+		.type = p_type,
+		.data = p_data,
+		.line = p_tokenizer->line,
+		.offset = p_tokenizer->token_start,
+		.length = p_tokenizer->pos - p_tokenizer->token_start,
+		.symbol = 0,
+		.text = p_tokenizer->data + p_tokenizer->token_start,
+		.source = p_tokenizer->source
+	};
+	return tk;
+}
+
+
+static Token *_create_literal(Tokenizer *p_tokenizer, Literal p_literal) {
+	p_tokenizer->literal = p_literal;
+	STATS_ADD(STAT_LITERALS, 1);
+	return _create_token(p_tokenizer, TK_LITERAL, &p_tokenizer->literal);
+}
+
+
+static bool _array_reserve(TokenArray *p_array, uint32_t p_capacity) {
+	if (p_capacity <= p_array->capacity)
+		return true;
+	#define GROW(F) {\
+		void *grown = realloc(p_array->F, p_capacity * sizeof(*p_array->F));\
+		if (!grown)\
+			return false;\
+		p_array->F = grown;\
+	}
+	GROW(types)
+	GROW(offsets)
+	GROW(lengths)
+	GROW(lines)
+	GROW(payloads)
+	#undef GROW
+	STATS_ADD(STAT_TOKEN_BYTES, (uint64_t)(p_capacity - p_array->capacity) * TOKEN_SLOT_SIZE);
+	p_array->capacity = p_capacity;
+	return true;
+}
+
+
+static uint32_t _array_add_literal(TokenArray *p_array, const Literal *p_literal) {
+	if (!p_literal && p_array->pool_count)
+		return 0;
+	if (p_array->pool_count == p_array->pool_capacity) {
+		uint32_t capacity = p_array->pool_capacity ? p_array->pool_capacity * 2 : 256;
+		Literal *grown = (Literal*)realloc(p_array->pool, capacity * sizeof(Literal));
+		if (!grown)
+			return 0;
+		STATS_ADD(STAT_LITERAL_BYTES, (uint64_t)(capacity - p_array->pool_capacity) * sizeof(Literal));
+		p_array->pool = grown;
+		p_array->pool_capacity = capacity;
+	}
+	p_array->pool[p_array->pool_count] = p_literal ? *p_literal : (Literal){0};
+	return p_array->pool_count++;
+}
+
+
+static inline uint32_t _array_first(const TokenArray *p_array) {
+	return p_array->count > p_array->capacity ? p_array->count - p_array->capacity : 0;
+}
+
+
+static void _array_free_slot(TokenArray *p_array, uint32_t p_slot) {
+	if (p_array->types[p_slot] == TK_LITERAL && p_array->payloads[p_slot])
+		literalRelease(&p_array->pool[p_array->payloads[p_slot]]);
+}
+
+
+static void _array_release(TokenArray *p_array) {
+	free(p_array->types);
+	free(p_array->offsets);
+	free(p_array->lengths);
+	free(p_array->lines);
+	free(p_array->payloads);
+	free(p_array->pool);
+}
+
+
+static void _array_free(TokenArray *p_array) {
+	for (uint32_t i = _array_first(p_array); i < p_array->count; i++)
+		_array_free_slot(p_array, i & p_array->mask);
+	_array_release(p_array);
+	*p_array = (TokenArray){0};
+}
+
+
+/*
+ * Double the ring, the retained tokens move to their slot under the new mask.
+*/
+static bool _ring_grow(TokenArray *p_array) {
+	uint32_t capacity = p_array->capacity ? p_array->capacity * 2 : TOKEN_RING_SIZE;
+	TokenArray ring = {
+		.types = (uint8_t*)malloc(capacity * sizeof(uint8_t)),
+		.offsets = (uint32_t*)malloc(capacity * sizeof(uint32_t)),
+		.lengths = (uint32_t*)malloc(capacity * sizeof(uint32_t)),
+		.lines = (uint32_t*)malloc(capacity * sizeof(uint32_t)),
+		.payloads = (uint32_t*)malloc(capacity * sizeof(uint32_t)),
+		.count = p_array->count,
+		.capacity = capacity,
+		.mask = capacity - 1,
+		.pool = (Literal*)calloc(capacity + 1, sizeof(Literal)),
+		.pool_count = capacity + 1,
+		.pool_capacity = capacity + 1
+	};
+	if (!ring.types || !ring.offsets || !ring.lengths || !ring.lines || !ring.payloads || !ring.pool) {
+		_array_release(&ring);
+		return false;
+	}
+	STATS_ADD(STAT_TOKEN_BYTES, (uint64_t)capacity * TOKEN_SLOT_SIZE);
+	STATS_ADD(STAT_LITERAL_BYTES, (uint64_t)(capacity + 1) * sizeof(Literal));
+	for (uint32_t i = _array_first(p_array); i < p_array->count; i++) {
+		uint32_t from = i & p_array->mask;
+		uint32_t to = i & ring.mask;
+		ring.types[to] = p_array->types[from];
+		ring.offsets[to] = p_array->offsets[from];
+		ring.lengths[to] = p_array->lengths[from];
+		ring.lines[to] = p_array->lines[from];
+		uint32_t payload = p_array->payloads[from];
+		if (ring.types[to] == TK_LITERAL && payload) {
+			ring.pool[to + 1] = p_array->pool[payload];
+			payload = to + 1;
+		}
+		ring.payloads[to] = payload;
+	}
+	_array_release(p_array);
+	*p_array = ring;
+	return true;
+}
+
+
+/*
+ * The oldest token that can still be returned to, the ring never recycles it.
+*/
+static inline uint32_t _oldest_needed(const Tokenizer *p_tokenizer) {
+	if (p_tokenizer->mark_count)
+		return p_tokenizer->marks[0];
+	return p_tokenizer->cursor == NO_TOKEN ? 0 : p_tokenizer->cursor;
+}
+
+
+static bool _array_push(Tokenizer *p_tokenizer, const Token *p_token) {
+	TokenArray *array = &p_tokenizer->tokens;
+	uint32_t i = array->count;
+	if (array->mask == WHOLE_FILE) {
+		if (i == array->capacity && !_array_reserve(array, array->capacity * 2))
+			return false;
+	} else {
+		while (i >= array->capacity && i - array->capacity >= _oldest_needed(p_tokenizer))
+			if (!_ring_grow(array))
+				return false;
+		if (i >= array->capacity)
+			_array_free_slot(array, i & array->mask);
+	}
+	uint32_t slot = i & array->mask;
+	array->types[slot] = (uint8_t)p_token->type;
+	array->offsets[slot] = p_token->offset;
+	array->lengths[slot] = p_token->length;
+	array->lines[slot] = p_token->line;
 	switch (p_token->type) {
-		case TK_LITERAL:
 		case TK_IDENTIFIER:
-			if(p_token->data)
-				literalFree((Literal*)p_token->data);
+			array->payloads[slot] = p_token->symbol;
+			break;
+		case TK_ERROR:
+			array->payloads[slot] = (const char**)p_token->data - errors;
+			break;
+		case TK_LITERAL:
+			if (array->mask == WHOLE_FILE)
+				array->payloads[slot] = _array_add_literal(array, p_token->data);
+			else {
+				array->pool[slot + 1] = *(const Literal*)p_token->data;
+				array->payloads[slot] = slot + 1;
+			}
+			break;
 		default:
+			array->payloads[slot] = 0;
 			break;
 	}
-	free(p_token);
+	array->count++;
+	return true;
 }
 
 
-static Token *_create_token(Tokenizer *p_tokenizer, TokenType p_type, void *p_data) {
-	Token *tk = (Token*)malloc(sizeof(Token));
-	if (!tk)
-		return NULL;
-	tk->type = p_type;
-	tk->data = p_data;
-	tk->line = p_tokenizer->line;
-	tk->source = p_tokenizer->source;
-	if (p_tokenizer->current_tk && p_tokenizer->tk_should_be_free)
-		_free_token(p_tokenizer->current_tk);
-	p_tokenizer->current_tk = tk;
-	return tk;
+static Token *_load_token(Tokenizer *p_tokenizer, uint32_t p_index) {
+	const TokenArray *array = &p_tokenizer->tokens;
+	uint32_t slot = p_index & array->mask;
+	TokenType type = (TokenType)array->types[slot];
+	uint32_t payload = array->payloads[slot];
+	void *data = NULL;
+	if (type == TK_LITERAL && payload)
+		data = &array->pool[payload];
+	else if (type == TK_ERROR)
+		data = (void*)&errors[payload];
+	p_tokenizer->token = (Token){
+		.type = type,
+		.data = data,
+		.line = array->lines[slot],
+		.offset = array->offsets[slot],
+		.length = array->lengths[slot],
+		.symbol = type == TK_IDENTIFIER ? payload : 0,
+		.text = p_tokenizer->data + array->offsets[slot],
+		.source = p_tokenizer->source
+	};
+	p_tokenizer->view = p_index;
+	return &p_tokenizer->token;
 }
 
 
-static TokenType _which_identifier(const char *p_str, size_t p_len) {
-	if (p_len > MAX_KEYWORD_LENGTH || p_len < MIN_KEYWORD_LENGTH)
+static inline TokenType _which_identifier(const char *p_str, size_t p_len) {
+	if (p_len > KEYWORD_MAX_LENGTH || p_len < KEYWORD_MIN_LENGTH)
 		return TK_IDENTIFIER;
-	
-	#define KEYWORD_GROUP(CHAR) \
-			break;\
-		case CHAR:
-	#define KEYWORD(N, T) \
-		if (p_len == sizeof(N) - 1)\
-			if (!strncmp(token_names[T], p_str, p_len))\
-				return T;
-	
-	switch (*p_str) {
-		case '\0':
-		KEYWORD_GROUP('a')
-			KEYWORD("as", TK_AS)
-			KEYWORD("and", TK_AND)
-			KEYWORD("assert", TK_ASSERT)
-			KEYWORD("await", TK_AWAIT)
-		KEYWORD_GROUP('b')
-			KEYWORD("break", TK_BREAK)
-			KEYWORD("breakpoint", TK_BREAKPOINT)
-		KEYWORD_GROUP('c')
-			KEYWORD("class", TK_CLASS)
-			KEYWORD("class_name", TK_CLASS_NAME)
-			KEYWORD("const", TK_CONST)
-			KEYWORD("continue", TK_CONTINUE)
-		KEYWORD_GROUP('e')
-			KEYWORD("elif", TK_ELIF)
-			KEYWORD("else", TK_ELSE)
-			KEYWORD("enum", TK_ENUM)
-			KEYWORD("extends", TK_EXTENDS)
-		KEYWORD_GROUP('f')
-			KEYWORD("for", TK_FOR)
-			KEYWORD("fn", TK_FN)
-		KEYWORD_GROUP('i')
-			KEYWORD("if", TK_IF)
-			KEYWORD("in", TK_IN)
-			KEYWORD("is", TK_IS)
-		KEYWORD_GROUP('l')
-			KEYWORD("let", TK_LET)
-		KEYWORD_GROUP('m')
-			KEYWORD("match", TK_MATCH)
-		KEYWORD_GROUP('n')
-			KEYWORD("not", TK_NOT)
-		KEYWORD_GROUP('o')
-			KEYWORD("or", TK_OR)
-		KEYWORD_GROUP('p')
-			KEYWORD("pass", TK_PASS)
-			KEYWORD("preload", TK_PRELOAD)
-		KEYWORD_GROUP('r')
-			KEYWORD("ret", TK_RET)
-		KEYWORD_GROUP('s')
-			KEYWORD("self", TK_SELF)
-			KEYWORD("signal", TK_SIGNAL)
-			KEYWORD("space", TK_SPACE)
-			KEYWORD("static", TK_STATIC)
-			KEYWORD("struct", TK_STRUCT)
-			KEYWORD("super", TK_SUPER)
-		KEYWORD_GROUP('t')
-			KEYWORD("trait", TK_TRAIT)
-			KEYWORD("type", TK_TYPE)
-		KEYWORD_GROUP('v')
-			KEYWORD("void", TK_VOID)
-		KEYWORD_GROUP('w')
-			KEYWORD("while", TK_WHILE)
-			KEYWORD("when", TK_WHEN)
-		KEYWORD_GROUP('y')
-			KEYWORD("yield", TK_YIELD)
-		KEYWORD_GROUP('I')
-			KEYWORD("inf", TK_CONST_INF)
-		KEYWORD_GROUP('N')
-			KEYWORD("nan", TK_CONST_NAN)
-		KEYWORD_GROUP('P')
-			KEYWORD("pi", TK_CONST_PI)
-		KEYWORD_GROUP('T')
-			KEYWORD("tau", TK_CONST_TAU)
-	}
+	uint32_t slot = KEYWORD_HASH(p_str, p_len);
+	if (keyword_table[slot].length == p_len && !memcmp(keyword_table[slot].name, p_str, p_len))
+		return (TokenType)keyword_table[slot].type;
 	return TK_IDENTIFIER;
-
-	#undef KEYWORD_GROUP
-	#undef KEYWORD
 }
 
 
 static Token *_parse_identifier(Tokenizer *p_tokenizer) {
-	char name[MAX_IDENTIFIER_LENGTH];
-	name[MAX_IDENTIFIER_LENGTH - 1] = '\0';
-	size_t len = 0;
-	bool has_digit = false;
-	for (int i = 0; i < MAX_IDENTIFIER_LENGTH - 1; i++) {
-		char c = _get_current_char(p_tokenizer);
-		if (_is_alpha(c) || _is_underscore(c))
-			goto set_char;
-		if (_is_digit(c)) {
-			has_digit = true;
-			goto set_char;
-		}
-		name[i] = '\0';
-		break;
-		set_char:
-			len++;
-			name[i] = c;
-			_consume(p_tokenizer);
-	}
+	size_t start = p_tokenizer->pos;
+	_skip_run(p_tokenizer, scanIdentifier);
+	size_t len = p_tokenizer->pos - start;
+	const char *name = p_tokenizer->data + start;
 
 	if (len == 1 && _is_underscore(*name))
 		return _create_token(p_tokenizer, TK_UNDERSCORE, NULL);
 
-	if (len == MAX_IDENTIFIER_LENGTH - 1 && _is_alphanum(_get_current_char(p_tokenizer)))
+	if (len >= MAX_IDENTIFIER_LENGTH)
 		return _create_token(p_tokenizer, TK_ERROR, (void*)ERR(IDENTIFIER_TOO_LONG));
 
-	TokenType tk_type = has_digit ? TK_IDENTIFIER : _which_identifier(name, len);
-	Literal *lt = NULL;
+	// The name is the token's own source span, nothing to copy
+	TokenType tk_type = _which_identifier(name, len);
+	Token *tk = _create_token(p_tokenizer, tk_type, NULL);
 	if (tk_type == TK_IDENTIFIER)
-		lt = literalCreate(LT_STRING, (void*)name);
-	return _create_token(p_tokenizer, tk_type, (void*)lt);
+		tk->symbol = internerIntern(p_tokenizer->interner, name, len);
+	return tk;
 }
 
 
-static Token *_parse_number(Tokenizer *p_tokenizer) {
-	char buffer[MAX_NUMBER_LENGTH];
-	buffer[MAX_NUMBER_LENGTH - 1] = '\0';
-	size_t len = 0;
-	memset(buffer, 0, MAX_NUMBER_LENGTH);
-	enum {
-		INT,
-		FLOAT
-	} type = INT;
-
-	for (int i = 0; i < MAX_NUMBER_LENGTH - 1; i++) {
+static inline char _get_next_char(Tokenizer *p_tokenizer) {
+	while (p_tokenizer->pos + 1 >= p_tokenizer->size) {
+		if (p_tokenizer->is_eof)
+			return -1;
+		_underflow(p_tokenizer);
+	}
+	return p_tokenizer->data[p_tokenizer->pos + 1];
+}
+
+
+static inline unsigned _digit_value(char p_char) {
+	if (p_char >= '0' && p_char <= '9')
+		return p_char - '0';
+	p_char |= 0x20;
+	if (p_char >= 'a' && p_char <= 'f')
+		return p_char - 'a' + 10;
+	return 16;
+}
+
+
+static LiteralSuffix _parse_number_suffix(Tokenizer *p_tokenizer) {
+	static const struct {
+		char name[4];
+		LiteralSuffix suffix;
+	} suffixes[] = {
+		{"i8", LS_I8}, {"i16", LS_I16}, {"i32", LS_I32}, {"i64", LS_I64},
+		{"u8", LS_U8}, {"u16", LS_U16}, {"u32", LS_U32}, {"u64", LS_U64},
+		{"f32", LS_F32}, {"f64", LS_F64},
+	};
+	char name[4] = {0};
+	for (size_t len = 0; len < 3; len++) {
 		char c = _get_current_char(p_tokenizer);
-		if (_is_digit(c))
-			goto set_char;
-		if (c == '.') {
-			if (type == FLOAT)
+		if (!_is_alpha(c) && !_is_digit(c))
+			break;
+		name[len] = c;
+		_consume(p_tokenizer);
+	}
+	for (size_t i = 0; i < sizeof(suffixes) / sizeof(*suffixes); i++)
+		if (!strcmp(name, suffixes[i].name))
+			return suffixes[i].suffix;
+	return LS_NONE;
+}
+
+
+/*
+ * Folds the decimal digits at the current position into p_value, runs of
+ * them found by scanDigits and separators skipped in between. Integer
+ * digits all go in and set p_overflow once the value wraps; with
+ * p_exponent, fraction digits go in while they fit and count down the
+ * exponent, the rest only set p_overflow.
+*/
+static void _fold_digits(Tokenizer *p_tokenizer, uint64_t *p_value, bool *p_overflow, int *p_exponent) {
+	while (true) {
+		const char *data = p_tokenizer->data;
+		const char *c = data + p_tokenizer->pos;
+		const char *end = scanDigits(c, data + p_tokenizer->size);
+		for (; c < end; c++) {
+			unsigned digit = *c - '0';
+			if (!p_exponent) {
+				*p_overflow |= __builtin_mul_overflow(*p_value, 10, p_value);
+				*p_overflow |= __builtin_add_overflow(*p_value, digit, p_value);
+			} else if (*p_value <= (UINT64_MAX - 9) / 10) {
+				*p_value = *p_value * 10 + digit;
+				(*p_exponent)--;
+			} else {
+				*p_overflow = true;
+			}
+		}
+		p_tokenizer->pos = end - data;
+		// The run goes on past what was read of a stream, or after a separator
+		char next = _get_current_char(p_tokenizer);
+		if (_is_underscore(next))
+			_consume(p_tokenizer);
+		else if (!_is_digit(next))
+			return;
+	}
+}
+
+
+/*
+ * Single pass over the literal: digits are accumulated as they are consumed,
+ * decimals as a mantissa and a power of ten. Floats that the fast path can't
+ * round exactly fall back to strtod on the digits.
+*/
+static Token *_parse_number(Tokenizer *p_tokenizer) {
+	size_t start = p_tokenizer->pos;
+	unsigned base = 10;
+	uint64_t value = 0;
+	bool overflow = false;
+	bool is_float = false;
+	int exponent = 0;
+
+	if (_get_current_char(p_tokenizer) == '0') {
+		char prefix = _get_next_char(p_tokenizer) | 0x20;
+		if (prefix == 'x' || prefix == 'b') {
+			base = prefix == 'x' ? 16 : 2;
+			_consume(p_tokenizer);
+			_consume(p_tokenizer);
+			if (_digit_value(_get_current_char(p_tokenizer)) >= base)
 				goto invalid;
-			type = FLOAT;
-			goto set_char;
 		}
-		buffer[i] = '\0';
-		break;
+	}
+
+	char c;
+	if (base == 10) {
+		_fold_digits(p_tokenizer, &value, &overflow, NULL);
+		c = _get_current_char(p_tokenizer);
+	} else {
+		for (;; _consume(p_tokenizer)) {
+			c = _get_current_char(p_tokenizer);
+			unsigned digit = _digit_value(c);
+			if (digit >= base) {
+				if (_is_underscore(c))
+					continue;
+				break;
+			}
+			overflow |= __builtin_mul_overflow(value, base, &value);
+			overflow |= __builtin_add_overflow(value, digit, &value);
+		}
+	}
+
+	if (base == 10 && c == '.' && _is_digit(_get_next_char(p_tokenizer))) {
+		is_float = true;
+		_consume(p_tokenizer);
+		// Digits that don't fit only matter to the slow path
+		_fold_digits(p_tokenizer, &value, &overflow, &exponent);
+		c = _get_current_char(p_tokenizer);
+		if (c == '.' && _is_digit(_get_next_char(p_tokenizer)))
+			goto invalid;
+	}
 
-		set_char:
-			len++;
-			buffer[i] = c;
+	if (base == 10 && (c == 'e' || c == 'E')) {
+		is_float = true;
+		_consume(p_tokenizer);
+		c = _get_current_char(p_tokenizer);
+		bool negative = c == '-';
+		if (c == '-' || c == '+') {
 			_consume(p_tokenizer);
+			c = _get_current_char(p_tokenizer);
+		}
+		if (!_is_digit(c))
+			goto invalid;
+		int exp = 0;
+		for (; _is_digit(c) || _is_underscore(c); _consume(p_tokenizer), c = _get_current_char(p_tokenizer))
+			if (_is_digit(c) && exp < MAX_EXPONENT)
+				exp = exp * 10 + (c - '0');
+		exponent += negative ? -exp : exp;
 	}
-	if (len == MAX_NUMBER_LENGTH - 1 && _is_digit(_get_current_char(p_tokenizer)))
+
+	size_t digits_end = p_tokenizer->pos;
+	LiteralSuffix suffix = LS_NONE;
+	if (c == 'i' || c == 'u' || c == 'f') {
+		suffix = _parse_number_suffix(p_tokenizer);
+		if (suffix == LS_NONE)
+			goto invalid;
+		c = _get_current_char(p_tokenizer);
+	}
+	if (_is_alpha(c) || _is_digit(c) || _is_underscore(c))
 		goto invalid;
-	
-	// FIXME: GET NUMBER SUFFIX
-	
-	Literal *lt;
-	switch (type) {
-		case INT:;
-			int integer = strtol(buffer, NULL, 10);
-			lt = literalCreate(LT_INT, &integer);
-			break;
-		case FLOAT:;
-			float floating_point = strtof(buffer, NULL);
-			lt = literalCreate(LT_FLOAT, &floating_point);
-			break;
+
+	if (is_float || suffix == LS_F32 || suffix == LS_F64) {
+		if (base != 10 || (suffix != LS_NONE && suffix != LS_F32 && suffix != LS_F64))
+			goto invalid;
+		bool single = suffix == LS_F32;
+		double floating_point;
+		if (overflow || !literalFloatFromDecimal(value, exponent, single, &floating_point)) {
+			// Copied without the separators, the text may not end right after it
+			char small[MAX_NUMBER_LENGTH];
+			char *buffer = digits_end - start < MAX_NUMBER_LENGTH ? small : (char*)malloc(digits_end - start + 1);
+			if (!buffer)
+				abort();
+			size_t len = 0;
+			for (size_t i = start; i < digits_end; i++)
+				if (!_is_underscore(p_tokenizer->data[i]))
+					buffer[len++] = p_tokenizer->data[i];
+			buffer[len] = '\0';
+			floating_point = single ? strtof(buffer, NULL) : strtod(buffer, NULL);
+			if (buffer != small)
+				free(buffer);
+			if (isinf(floating_point))
+				goto out_of_range;
+		}
+		return _create_literal(p_tokenizer, literalCreateFloat(floating_point, suffix));
 	}
 
-	return _create_token(p_tokenizer, TK_LITERAL, (void*)lt);
+	static const uint64_t max_values[] = {
+		[LS_NONE] = UINT64_MAX,
+		[LS_I8] = INT8_MAX,
+		[LS_I16] = INT16_MAX,
+		[LS_I32] = INT32_MAX,
+		[LS_I64] = INT64_MAX,
+		[LS_U8] = UINT8_MAX,
+		[LS_U16] = UINT16_MAX,
+		[LS_U32] = UINT32_MAX,
+		[LS_U64] = UINT64_MAX,
+	};
+	if (overflow || value > max_values[suffix])
+		goto out_of_range;
+	// Unsuffixed integers are i64 unless only u64 can hold them
+	if (suffix >= LS_U8 || value > INT64_MAX)
+		return _create_literal(p_tokenizer, literalCreateUInt(value, suffix));
+	return _create_literal(p_tokenizer, literalCreateInt((int64_t)value, suffix));
+
 	invalid:
 		return _create_token(p_tokenizer, TK_ERROR, (void*)ERR(INVALID_NUMBER));
+	out_of_range:
+		return _create_token(p_tokenizer, TK_ERROR, (void*)ERR(NUMBER_OUT_OF_RANGE));
 }
 
 
 static Token *_parse_string(Tokenizer *p_tokenizer) {
 	_consume(p_tokenizer);
+	size_t start = p_tokenizer->pos;
 	char c;
 	while (c = _get_current_char(p_tokenizer), c != '"') {
-		if (c == -1)
-			return _create_token(p_tokenizer, TK_ERROR, (void*)ERR(UNTERMINATED_STRING));
+		switch (c) {
+			case -1:
+				return _create_token(p_tokenizer, TK_ERROR, (void*)ERR(UNTERMINATED_STRING));
+			case '\n':
+				p_tokenizer->line++;
+				break;
+			case '\\':
+				_consume(p_tokenizer);
+				if (_get_current_char(p_tokenizer) == -1)
+					return _create_token(p_tokenizer, TK_ERROR, (void*)ERR(UNTERMINATED_STRING));
+				break;
+		}
 		_consume(p_tokenizer);
 	}
+	// Escapes are left in place, they are decoded when the value is asked for
+	Literal lt = literalCreateString(p_tokenizer->data + start, p_tokenizer->pos - start);
 	_consume(p_tokenizer);
-	Literal *lt = literalCreate(LT_STRING, "Good Job");
-	return _create_token(p_tokenizer, TK_LITERAL, (void*)lt);
+	return _create_literal(p_tokenizer, lt);
 }
 
 
 static void _parse_comment(Tokenizer *p_tokenizer) {
-	char c;
-	while (c = _get_current_char(p_tokenizer), c != '\n' && c != -1)
-		_consume(p_tokenizer);
+	_skip_run(p_tokenizer, scanFindNewline);
 }
 
 
-Tokenizer *tokenizerInit(TkGetCharCallback p_get_char, void* p_bind_ctx, const char *p_source) {
+static Tokenizer *_create_tokenizer(InputType p_input, const char *p_source) {
 	Tokenizer* tk = (Tokenizer*)malloc(sizeof(Tokenizer));
+	if (!tk)
+		return NULL;
+	*tk = (Tokenizer){
+		.input = p_input,
+		.data = NULL,
+		.size = 0,
+		.pos = 0,
+		.is_eof = p_input != INPUT_STREAM,
+		.too_large = false,
+		.mapped_size = 0,
+		.stream = NULL,
+		.get_char_callback = NULL,
+		.callback_bind_ctx = NULL,
+		.interner = internerGlobal(),
+		.token_start = 0,
+		.tokens = {0},
+		.cursor = NO_TOKEN,
+		.view = NO_TOKEN,
+		.marks = NULL,
+		.mark_count = 0,
+		.mark_capacity = 0,
+		.line = 1,
+		.source = p_source,
+		.pipe = NULL
+	};
+	return tk;
+}
+
+
+Tokenizer *tokenizerInit(TkGetCharCallback p_get_char, void* p_bind_ctx, const char *p_source) {
+	Tokenizer *tk = _create_tokenizer(INPUT_STREAM, p_source);
 	if (!tk)
 		return NULL;
 	tk->get_char_callback = p_get_char;
 	tk->callback_bind_ctx = p_bind_ctx;
-	tk->current_tk = NULL;
-	tk->tk_should_be_free = true;
-	tk->last_char = -1;
-	tk->is_char_consumed = true;
-	tk->line = 1;
-	tk->source = p_source;
 	return tk;
 }
 
 
-Token *tokenizerAdvance(Tokenizer *p_tokenizer) {
+/*
+ * NULL with errno set to EFBIG for a buffer over MAX_INPUT_SIZE.
+*/
+Tokenizer *tokenizerInitBuffer(const char *p_buffer, size_t p_size, const char *p_source) {
+	if (p_size > MAX_INPUT_SIZE) {
+		errno = EFBIG;
+		return NULL;
+	}
+	Tokenizer *tk = _create_tokenizer(INPUT_BUFFER, p_source);
+	if (!tk)
+		return NULL;
+	tk->data = p_buffer;
+	tk->size = p_size;
+	return tk;
+}
+
+
+static Tokenizer *_open_file(const char *p_path) {
+	int fd = open(p_path, O_RDONLY);
+	if (fd < 0)
+		return NULL;
+	Tokenizer *tk = _create_tokenizer(INPUT_MAPPED, p_path);
+	if (!tk)
+		goto fail;
+	struct stat st;
+	if (fstat(fd, &st) == 0 && S_ISREG(st.st_mode)) {
+		if ((uint64_t)st.st_size > MAX_INPUT_SIZE) {
+			free(tk);
+			errno = EFBIG;
+			goto fail;
+		}
+		if (st.st_size == 0) {
+			close(fd);
+			return tk;
+		}
+		void *map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+		if (map != MAP_FAILED) {
+			posix_madvise(map, st.st_size, POSIX_MADV_SEQUENTIAL);
+			tk->data = (const char*)map;
+			tk->size = st.st_size;
+			tk->mapped_size = st.st_size;
+			close(fd);
+			return tk;
+		}
+	}
+
+	// Not mappable (pipe, special file...), slurp it instead
+	tk->input = INPUT_HEAP;
+	size_t capacity = STREAM_CHUNK_SIZE;
+	char *buffer = (char*)malloc(capacity);
+	while (buffer) {
+		ssize_t n = read(fd, buffer + tk->size, capacity - tk->size);
+		if (n < 0)
+			break;
+		if (n == 0) {
+			tk->data = buffer;
+			close(fd);
+			return tk;
+		}
+		tk->size += n;
+		if (tk->size > MAX_INPUT_SIZE) {
+			errno = EFBIG;
+			break;
+		}
+		if (tk->size == capacity) {
+			char *grown = (char*)realloc(buffer, capacity *= 2);
+			if (!grown)
+				break;
+			buffer = grown;
+		}
+	}
+	free(buffer);
+	free(tk);
+	fail:
+		close(fd);
+		return NULL;
+}
+
+
+Tokenizer *tokenizerInitFile(const char *p_path) {
+	uint64_t start = traceBegin();
+	Tokenizer *tk = _open_file(p_path);
+	if (tk)
+		STATS_ADD(STAT_BYTES_READ, tk->size);
+	traceEnd("Read", p_path, start);
+	return tk;
+}
+
+
+static Token *_lex(Tokenizer *p_tokenizer) {
 	start:;
+	p_tokenizer->token_start = p_tokenizer->pos;
 	char c = _get_current_char(p_tokenizer);
 	switch (c) {
 		case -1:
+			if (p_tokenizer->too_large)
+				return _create_token(p_tokenizer, TK_ERROR, (void*)ERR(INPUT_TOO_LARGE));
 			return _create_token(p_tokenizer, TK_EOF, NULL);
 		case '\n':
-			p_tokenizer->line++;
-			__attribute__((fallthrough));
 		case '\t':
 		case ' ':
-			_consume(p_tokenizer);
+			_skip_blank(p_tokenizer);
 			goto start;
 		case '@':
 			_consume(p_tokenizer);
@@ -477,6 +1051,10 @@ Token *tokenizerAdvance(Tokenizer *p_tokenizer) {
 					return _create_token(p_tokenizer, TK_LESS_EQUAL, NULL);
 				case '<':
 					_consume(p_tokenizer);
+					if (_get_current_char(p_tokenizer) == '=') {
+						_consume(p_tokenizer);
+						return _create_token(p_tokenizer, TK_LESS_LESS_EQUAL, NULL);
+					}
 					return _create_token(p_tokenizer, TK_LESS_LESS, NULL);
 			}
 			return _create_token(p_tokenizer, TK_LESS, NULL);
@@ -486,8 +1064,12 @@ Token *tokenizerAdvance(Tokenizer *p_tokenizer) {
 				case '=':
 					_consume(p_tokenizer);
 					return _create_token(p_tokenizer, TK_GREATER_EQUAL, NULL);
-				case '<':
+				case '>':
 					_consume(p_tokenizer);
+					if (_get_current_char(p_tokenizer) == '=') {
+						_consume(p_tokenizer);
+						return _create_token(p_tokenizer, TK_GREATER_GREATER_EQUAL, NULL);
+					}
 					return _create_token(p_tokenizer, TK_GREATER_GREATER, NULL);
 			}
 			return _create_token(p_tokenizer, TK_GREATER, NULL);
@@ -565,6 +1147,10 @@ Token *tokenizerAdvance(Tokenizer *p_tokenizer) {
 				}
 				return _create_token(p_tokenizer, TK_STAR_STAR, NULL);
 			}
+			if (_get_current_char(p_tokenizer) == '=') {
+				_consume(p_tokenizer);
+				return _create_token(p_tokenizer, TK_STAR_EQUAL, NULL);
+			}
 			return _create_token(p_tokenizer, TK_STAR, NULL);
 		case '/':
 			_consume(p_tokenizer);
@@ -634,33 +1220,473 @@ Token *tokenizerAdvance(Tokenizer *p_tokenizer) {
 }
 
 
+/*
+ * Lexer thread pipeline
+*/
+
+
+static bool _pipe_has_batch(const TokenPipe *p_pipe) {
+	return atomic_load(&p_pipe->published) != atomic_load(&p_pipe->released);
+}
+
+
+static bool _pipe_has_room(const TokenPipe *p_pipe) {
+	return atomic_load(&p_pipe->published) - atomic_load(&p_pipe->released) < PIPE_DEPTH ||
+		atomic_load(&p_pipe->closed);
+}
+
+
+static void _pipe_wait(TokenPipe *p_pipe, bool (*p_ready)(const TokenPipe*)) {
+	for (int i = 0; i < PIPE_SPINS; i++)
+		if (p_ready(p_pipe))
+			return;
+	pthread_mutex_lock(&p_pipe->lock);
+	atomic_fetch_add(&p_pipe->sleepers, 1);
+	while (!p_ready(p_pipe))
+		pthread_cond_wait(&p_pipe->wake, &p_pipe->lock);
+	atomic_fetch_sub(&p_pipe->sleepers, 1);
+	pthread_mutex_unlock(&p_pipe->lock);
+}
+
+
+/*
+ * Called after moving a counter: a sleeper registered itself before looking
+ * at the counters, so either it sees the move or it is seen here.
+*/
+static void _pipe_notify(TokenPipe *p_pipe) {
+	if (!atomic_load(&p_pipe->sleepers))
+		return;
+	pthread_mutex_lock(&p_pipe->lock);
+	pthread_cond_broadcast(&p_pipe->wake);
+	pthread_mutex_unlock(&p_pipe->lock);
+}
+
+
+static void *_pipe_lex(void *p_ctx) {
+	TokenPipe *pipe = (TokenPipe*)p_ctx;
+	traceNameThread("Lexer");
+	uint64_t start = traceBegin();
+	TokenType type;
+	do {
+		_pipe_wait(pipe, _pipe_has_room);
+		if (atomic_load(&pipe->closed))
+			break;
+		PipeBatch *batch = &pipe->batches[atomic_load(&pipe->published) % PIPE_DEPTH];
+		batch->count = 0;
+		do {
+			Token *tk = _lex(pipe->lexer);
+			type = tk->type;
+			Token *slot = &batch->tokens[batch->count];
+			*slot = *tk;
+			if (type == TK_LITERAL) {
+				batch->literals[batch->count] = *(const Literal*)tk->data;
+				slot->data = &batch->literals[batch->count];
+			}
+			batch->count++;
+		} while (batch->count < PIPE_BATCH_SIZE && type != TK_EOF && type != TK_ERROR);
+		atomic_fetch_add(&pipe->published, 1);
+		_pipe_notify(pipe);
+	} while (type != TK_EOF && type != TK_ERROR);
+	traceEnd("Lex", pipe->lexer->source, start);
+	return NULL;
+}
+
+
+/*
+ * The next token from the lexer thread. Its batch is only handed back on
+ * the following call, once the token was copied into the ring.
+*/
+static Token *_pipe_next(Tokenizer *p_tokenizer) {
+	TokenPipe *pipe = p_tokenizer->pipe;
+	uint32_t released = atomic_load_explicit(&pipe->released, memory_order_relaxed);
+	if (pipe->read && pipe->read == pipe->batches[released % PIPE_DEPTH].count) {
+		pipe->read = 0;
+		atomic_store(&pipe->released, ++released);
+		_pipe_notify(pipe);
+	}
+	if (!pipe->read)
+		_pipe_wait(pipe, _pipe_has_batch);
+	Token *tk = &pipe->batches[released % PIPE_DEPTH].tokens[pipe->read++];
+	// Stream blocks only grow and are all kept, the latest one holds every token so far
+	p_tokenizer->data = tk->text - tk->offset;
+	return tk;
+}
+
+
+/*
+ * Stops the lexer thread and drops the tokens the parser never took.
+*/
+static void _pipe_close(TokenPipe *p_pipe) {
+	atomic_store(&p_pipe->closed, true);
+	_pipe_notify(p_pipe);
+	pthread_join(p_pipe->thread, NULL);
+	uint32_t published = atomic_load(&p_pipe->published);
+	for (uint32_t i = atomic_load(&p_pipe->released); i != published; i++) {
+		PipeBatch *batch = &p_pipe->batches[i % PIPE_DEPTH];
+		for (uint32_t j = p_pipe->read; j < batch->count; j++)
+			_free_token_data(&batch->tokens[j]);
+		p_pipe->read = 0;
+	}
+	tokenizerTerminate(p_pipe->lexer);
+	pthread_mutex_destroy(&p_pipe->lock);
+	pthread_cond_destroy(&p_pipe->wake);
+	free(p_pipe);
+}
+
+
+static inline Token *_next(Tokenizer *p_tokenizer) {
+	return p_tokenizer->pipe ? _pipe_next(p_tokenizer) : _lex(p_tokenizer);
+}
+
+
+/*
+ * Lex until token p_index is stored, clamped to the final EOF or error token.
+*/
+static uint32_t _reach(Tokenizer *p_tokenizer, uint32_t p_index) {
+	TokenArray *array = &p_tokenizer->tokens;
+	while (array->count <= p_index) {
+		if (array->count) {
+			TokenType last = (TokenType)array->types[(array->count - 1) & array->mask];
+			if (last == TK_EOF || last == TK_ERROR)
+				return array->count - 1;
+		}
+		Token *tk = _next(p_tokenizer);
+		if (!_array_push(p_tokenizer, tk)) {
+			_free_token_data(tk);
+			return array->count - 1;
+		}
+	}
+	return p_index;
+}
+
+
+Token *tokenizerAdvance(Tokenizer *p_tokenizer) {
+	// NO_TOKEN + 1 wraps to the first token
+	p_tokenizer->cursor = _reach(p_tokenizer, p_tokenizer->cursor + 1);
+	return _load_token(p_tokenizer, p_tokenizer->cursor);
+}
+
+
+static size_t _lex_all(Tokenizer *p_tokenizer) {
+	TokenArray *array = &p_tokenizer->tokens;
+	assert(!array->count);
+	_array_free(array);
+	array->mask = WHOLE_FILE;
+	// Roughly one token every 4 bytes of source
+	uint32_t hint = p_tokenizer->input == INPUT_STREAM ? 1024 : p_tokenizer->size / 4 + 16;
+	if (!_array_reserve(array, hint))
+		return 0;
+	// Pool slot 0 stands for "no payload"
+	_array_add_literal(array, NULL);
+
+	TokenType type;
+	do {
+		Token *tk = _next(p_tokenizer);
+		type = tk->type;
+		if (!_array_push(p_tokenizer, tk)) {
+			_free_token_data(tk);
+			return 0;
+		}
+	} while (type != TK_EOF && type != TK_ERROR);
+	return array->count;
+}
+
+
+size_t tokenizerLexAll(Tokenizer *p_tokenizer) {
+	uint64_t start = traceBegin();
+	size_t count = _lex_all(p_tokenizer);
+	traceEnd("Lex", p_tokenizer->source, start);
+	return count;
+}
+
+
+/*
+ * Moves lexing of a stream to a thread of its own that runs ahead of the
+ * parser, reading and lexing the input then overlap with parsing it. Only
+ * before the first token; false when the input is not a stream or the
+ * thread did not start, tokens are then lexed on demand as before.
+*/
+bool tokenizerStartLexerThread(Tokenizer *p_tokenizer) {
+	if (p_tokenizer->input != INPUT_STREAM || p_tokenizer->pipe || p_tokenizer->tokens.count || p_tokenizer->size)
+		return false;
+	TokenPipe *pipe = (TokenPipe*)aligned_alloc(_Alignof(TokenPipe), sizeof(TokenPipe));
+	if (!pipe)
+		return false;
+	Tokenizer *lexer = _create_tokenizer(INPUT_STREAM, p_tokenizer->source);
+	if (!lexer) {
+		free(pipe);
+		return false;
+	}
+	lexer->get_char_callback = p_tokenizer->get_char_callback;
+	lexer->callback_bind_ctx = p_tokenizer->callback_bind_ctx;
+	lexer->line = p_tokenizer->line;
+	pipe->lexer = lexer;
+	pipe->read = 0;
+	atomic_init(&pipe->published, 0);
+	atomic_init(&pipe->released, 0);
+	atomic_init(&pipe->closed, false);
+	atomic_init(&pipe->sleepers, 0);
+	pthread_mutex_init(&pipe->lock, NULL);
+	pthread_cond_init(&pipe->wake, NULL);
+	if (pthread_create(&pipe->thread, NULL, _pipe_lex, pipe)) {
+		pthread_mutex_destroy(&pipe->lock);
+		pthread_cond_destroy(&pipe->wake);
+		tokenizerTerminate(lexer);
+		free(pipe);
+		return false;
+	}
+	p_tokenizer->pipe = pipe;
+	return true;
+}
+
+
+/*
+ * The whole source text, NULL for streams which never hold all of it.
+*/
+const char *tokenizerGetBuffer(const Tokenizer *p_tokenizer, size_t *p_size) {
+	if (p_tokenizer->input == INPUT_STREAM)
+		return NULL;
+	*p_size = p_tokenizer->size;
+	return p_tokenizer->data ? p_tokenizer->data : "";
+}
+
+
+uint32_t tokenizerGetIndex(Tokenizer *p_tokenizer) {
+	if (p_tokenizer->cursor == NO_TOKEN)
+		p_tokenizer->cursor = 0;
+	return p_tokenizer->cursor;
+}
+
+
+/*
+ * Moves past a "{...}" block, the current token being its "{", without
+ * lexing what is inside when nothing past the brace was lexed yet: braces
+ * are matched on the raw text, stepping over strings and comments. Whatever
+ * was already lexed is walked as tokens instead. On success the current
+ * token is the one after the closing brace and p_end is the offset just
+ * past it, otherwise the current token is where the text ran out.
+*/
+bool tokenizerSkipBlock(Tokenizer *p_tokenizer, uint32_t *p_end) {
+	const TokenArray *array = &p_tokenizer->tokens;
+	assert(tokenizerGetCurrentType(p_tokenizer) == TK_BRACE_OPEN);
+	int depth = 1;
+	if (p_tokenizer->input == INPUT_STREAM || array->count > p_tokenizer->cursor + 1) {
+		while (depth) {
+			switch (tokenizerAdvanceType(p_tokenizer)) {
+				case TK_BRACE_OPEN:
+					depth++;
+					break;
+				case TK_BRACE_CLOSE:
+					depth--;
+					break;
+				case TK_EOF:
+				case TK_ERROR:
+					return false;
+				default:
+					break;
+			}
+		}
+		*p_end = tokenizerTokenGetOffset(tokenizerGetCurrent(p_tokenizer)) + 1;
+		tokenizerAdvance(p_tokenizer);
+		return true;
+	}
+
+	const char *data = p_tokenizer->data;
+	const char *c = data + p_tokenizer->pos;
+	const char *end = data + p_tokenizer->size;
+	int lines = 0;
+	while (depth && c < end) {
+		switch (*c++) {
+			case '{':
+				depth++;
+				break;
+			case '}':
+				depth--;
+				break;
+			case '\n':
+				lines++;
+				break;
+			case '#':
+				c = scanFindNewline(c, end);
+				break;
+			case '"':
+				for (; c < end && *c != '"'; c++) {
+					if (*c == '\\' && c + 1 < end)
+						c++;
+					lines += *c == '\n';
+				}
+				c += c < end;
+				break;
+		}
+	}
+	// An unclosed block runs to the end, the current token is then EOF
+	p_tokenizer->pos = c - data;
+	p_tokenizer->line += lines;
+	*p_end = (uint32_t)p_tokenizer->pos;
+	tokenizerAdvance(p_tokenizer);
+	return !depth;
+}
+
+
+/*
+ * Makes a fresh tokenizer start in the middle of its text, at p_offset
+ * which is on line p_line.
+*/
+void tokenizerStartAt(Tokenizer *p_tokenizer, uint32_t p_offset, int p_line) {
+	assert(!p_tokenizer->tokens.count && p_tokenizer->input != INPUT_STREAM && p_offset <= p_tokenizer->size);
+	p_tokenizer->pos = p_offset;
+	p_tokenizer->line = p_line;
+}
+
+
+static bool _is_word(char p_char) {
+	return _is_alpha(p_char) || _is_digit(p_char) || _is_underscore(p_char);
+}
+
+
+/*
+ * Picks up to p_max places to cut the text left to lex so its pieces can be
+ * lexed and parsed apart: the first is where lexing stands, the others are
+ * top level lets about equally far from each other. Only brackets, strings
+ * and comments are followed, so text the parser rejects may be cut anywhere.
+ * Returns the number of pieces, 0 for streams and once tokens were lexed.
+*/
+size_t tokenizerSplit(const Tokenizer *p_tokenizer, size_t p_max, uint32_t *p_offsets, int *p_lines) {
+	if (p_tokenizer->input == INPUT_STREAM || p_tokenizer->tokens.count || !p_max)
+		return 0;
+	const char *data = p_tokenizer->data;
+	const char *c = data + p_tokenizer->pos;
+	const char *end = data + p_tokenizer->size;
+	int line = p_tokenizer->line;
+	p_offsets[0] = p_tokenizer->pos;
+	p_lines[0] = line;
+	size_t step = (end - c) / p_max;
+	if (!step)
+		return 1;
+	size_t count = 1;
+	const char *next = c + step;
+	int depth = 0;
+	while (c < end) {
+		switch (*c++) {
+			case '{':
+			case '(':
+			case '[':
+				depth++;
+				break;
+			case '}':
+			case ')':
+			case ']':
+				depth -= depth > 0;
+				break;
+			case '\n':
+				line++;
+				break;
+			case '#':
+				c = scanFindNewline(c, end);
+				break;
+			case '"':
+				for (; c < end && *c != '"'; c++) {
+					if (*c == '\\' && c + 1 < end)
+						c++;
+					line += *c == '\n';
+				}
+				c += c < end;
+				break;
+			case 'l':
+				if (depth || c <= next || end - c < 2 || c[0] != 'e' || c[1] != 't')
+					break;
+				if (_is_word(c[-2]) || (end - c > 2 && _is_word(c[2])))
+					break;
+				p_offsets[count] = c - 1 - data;
+				p_lines[count] = line;
+				if (++count == p_max)
+					return count;
+				next = c - 1 + step;
+				c += 2;
+				break;
+		}
+	}
+	return count;
+}
+
+
+const char *tokenizerGetSource(const Tokenizer *p_tokenizer) {
+	return p_tokenizer->source;
+}
+
+
+void tokenizerSeek(Tokenizer *p_tokenizer, uint32_t p_index) {
+	const TokenArray *array = &p_tokenizer->tokens;
+	assert(p_index < array->count && p_index >= _array_first(array));
+	p_tokenizer->cursor = p_index;
+}
+
+
+Token *tokenizerPeek(Tokenizer *p_tokenizer, uint32_t p_ahead) {
+	uint32_t index = _reach(p_tokenizer, tokenizerGetIndex(p_tokenizer) + p_ahead);
+	if (p_tokenizer->view != index)
+		_load_token(p_tokenizer, index);
+	return &p_tokenizer->token;
+}
+
+
+TokenType tokenizerPeekType(Tokenizer *p_tokenizer, uint32_t p_ahead) {
+	const TokenArray *array = &p_tokenizer->tokens;
+	uint32_t index = _reach(p_tokenizer, tokenizerGetIndex(p_tokenizer) + p_ahead);
+	return (TokenType)array->types[index & array->mask];
+}
+
+
+TokenType tokenizerIdentifierType(const char *p_str, size_t p_len) {
+	return _which_identifier(p_str, p_len);
+}
+
+
 TokenType tokenizerAdvanceType(Tokenizer *p_tokenizer) {
-	return tokenizerAdvance(p_tokenizer)->type;
+	const TokenArray *array = &p_tokenizer->tokens;
+	p_tokenizer->cursor = _reach(p_tokenizer, p_tokenizer->cursor + 1);
+	return (TokenType)array->types[p_tokenizer->cursor & array->mask];
 }
 
 
 Token *tokenizerGetCurrent(Tokenizer *p_tokenizer) {
-	if (!p_tokenizer->current_tk)
-		tokenizerAdvance(p_tokenizer);
-	return p_tokenizer->current_tk;
+	return tokenizerPeek(p_tokenizer, 0);
 }
 
 
 TokenType tokenizerGetCurrentType(Tokenizer *p_tokenizer) {
-	if (!p_tokenizer->current_tk)
-		tokenizerAdvance(p_tokenizer);
-	return p_tokenizer->current_tk->type;
+	return tokenizerPeekType(p_tokenizer, 0);
 }
 
 
+/*
+ * Marks nest: Pop rewinds to the latest mark, Commit drops it and keeps the
+ * position. Every token from the oldest mark on stays in the ring, so going
+ * back never lexes twice.
+*/
 void tokenizerPush(Tokenizer *p_tokenizer) {
-	// FIXME: IMPLEMENT THIS
+	if (p_tokenizer->mark_count == p_tokenizer->mark_capacity) {
+		uint32_t capacity = p_tokenizer->mark_capacity ? p_tokenizer->mark_capacity * 2 : 16;
+		uint32_t *grown = (uint32_t*)realloc(p_tokenizer->marks, capacity * sizeof(uint32_t));
+		if (!grown)
+			abort();
+		p_tokenizer->marks = grown;
+		p_tokenizer->mark_capacity = capacity;
+	}
+	p_tokenizer->marks[p_tokenizer->mark_count++] = tokenizerGetIndex(p_tokenizer);
 }
 
 
 Token *tokenizerPop(Tokenizer *p_tokenizer) {
-	// FIXME: IMPLEMENT THIS
-	return NULL;
+	assert(p_tokenizer->mark_count);
+	p_tokenizer->cursor = p_tokenizer->marks[--p_tokenizer->mark_count];
+	return tokenizerGetCurrent(p_tokenizer);
+}
+
+
+void tokenizerCommit(Tokenizer *p_tokenizer) {
+	assert(p_tokenizer->mark_count);
+	p_tokenizer->mark_count--;
 }
 
 
@@ -678,7 +1704,7 @@ Literal *tokenizerTokenGetLiteral(const Token *p_token) {
 
 const char *tokenizerTokenGetErrorString(const Token *p_token) {
 	if (p_token->type == TK_ERROR)
-		return (char*)p_token->data;
+		return *(const char**)p_token->data;
 	return NULL;
 }
 
@@ -703,6 +1729,26 @@ int tokenizerTokenGetLine(const Token *p_token) {
 }
 
 
+const char *tokenizerTokenGetText(const Token *p_token) {
+	return p_token->text;
+}
+
+
+uint32_t tokenizerTokenGetSymbol(const Token *p_token) {
+	return p_token->symbol;
+}
+
+
+uint32_t tokenizerTokenGetOffset(const Token *p_token) {
+	return p_token->offset;
+}
+
+
+uint32_t tokenizerTokenGetLength(const Token *p_token) {
+	return p_token->length;
+}
+
+
 const char *tokenizerTokenGetSource(const Token *p_token) {
 	return p_token->source;
 }
@@ -710,5 +1756,27 @@ const char *tokenizerTokenGetSource(const Token *p_token) {
 
 void tokenizerTerminate(Tokenizer *p_tokenizer)
 {
+	// The text of the tokens lives in the lexer's stream blocks
+	if (p_tokenizer->pipe)
+		_pipe_close(p_tokenizer->pipe);
+	switch (p_tokenizer->input) {
+		case INPUT_MAPPED:
+			if (p_tokenizer->mapped_size)
+				munmap((void*)p_tokenizer->data, p_tokenizer->mapped_size);
+			break;
+		case INPUT_HEAP:
+			free((void*)p_tokenizer->data);
+			break;
+		case INPUT_STREAM:
+			for (StreamBlock *block = p_tokenizer->stream, *prev; block; block = prev) {
+				prev = block->prev;
+				free(block);
+			}
+			break;
+		case INPUT_BUFFER:
+			break;
+	}
+	_array_free(&p_tokenizer->tokens);
+	free(p_tokenizer->marks);
 	free(p_tokenizer);
 }
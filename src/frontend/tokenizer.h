@@ -3,6 +3,9 @@
 
 #include "literal.h"
 
+#include <stddef.h>
+#include <stdint.h>
+
 typedef enum {
     TK_EMPTY,
     // Basic
@@ -129,12 +132,27 @@ typedef struct Token Token;
 
 
 Tokenizer *tokenizerInit(TkGetCharCallback p_get_char, void* p_bind_ctx, const char *p_source);
+Tokenizer *tokenizerInitBuffer(const char *p_buffer, size_t p_size, const char *p_source);
+Tokenizer *tokenizerInitFile(const char *p_path);
 Token *tokenizerAdvance(Tokenizer *p_tokenizer);
+size_t tokenizerLexAll(Tokenizer *p_tokenizer);
+bool tokenizerStartLexerThread(Tokenizer *p_tokenizer);
+const char *tokenizerGetBuffer(const Tokenizer *p_tokenizer, size_t *p_size);
+const char *tokenizerGetSource(const Tokenizer *p_tokenizer);
+void tokenizerStartAt(Tokenizer *p_tokenizer, uint32_t p_offset, int p_line);
+bool tokenizerSkipBlock(Tokenizer *p_tokenizer, uint32_t *p_end);
+size_t tokenizerSplit(const Tokenizer *p_tokenizer, size_t p_max, uint32_t *p_offsets, int *p_lines);
+uint32_t tokenizerGetIndex(Tokenizer *p_tokenizer);
+void tokenizerSeek(Tokenizer *p_tokenizer, uint32_t p_index);
+Token *tokenizerPeek(Tokenizer *p_tokenizer, uint32_t p_ahead);
+TokenType tokenizerPeekType(Tokenizer *p_tokenizer, uint32_t p_ahead);
 TokenType tokenizerAdvanceType(Tokenizer *p_tokenizer);
+TokenType tokenizerIdentifierType(const char *p_str, size_t p_len);
 Token *tokenizerGetCurrent(Tokenizer *p_tokenizer);
 TokenType tokenizerGetCurrentType(Tokenizer *p_tokenizer);
 void tokenizerPush(Tokenizer *p_tokenizer);
 Token *tokenizerPop(Tokenizer *p_tokenizer);
+void tokenizerCommit(Tokenizer *p_tokenizer);
 
 Literal *tokenizerTokenGetLiteral(const Token *p_token);
 const char *tokenizerTokenGetErrorString(const Token *p_token);
@@ -142,6 +160,10 @@ TokenType tokenizerTokenGetType(const Token *p_token);
 const char *tokenizerTokenGetTypeName(const Token *p_token);
 const char *tokenizerTokenTypeName(const TokenType p_type);
 int tokenizerTokenGetLine(const Token *p_token);
+const char *tokenizerTokenGetText(const Token *p_token);
+uint32_t tokenizerTokenGetSymbol(const Token *p_token);
+uint32_t tokenizerTokenGetOffset(const Token *p_token);
+uint32_t tokenizerTokenGetLength(const Token *p_token);
 const char *tokenizerTokenGetSource(const Token *p_token);
 
 void tokenizerTerminate(Tokenizer *p_tokenizer);
@@ -2,23 +2,286 @@
 
 #include "frontend/tokenizer.h"
 #include "frontend/parser.h"
+#include "syntax_tree/tree_cache.h"
+#include "driver/driver.h"
+#include "driver/server.h"
+#include "extra/stats.h"
+#include "extra/trace.h"
 
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/stat.h>
 
 char get_char(void *p_ctx) {
     return (char)getc((FILE*)p_ctx);
 }
 
+
+typedef struct {
+    Sink *out;
+    DumpFormat format;
+    bool headers;
+} Output;
+
+
+// What compiling needs beside the paths, the same for every request of a server
+typedef struct {
+    TreeCache *cache;
+    ModuleCache *modules;
+    int threads;
+    bool lazy_bodies;
+} Session;
+
+
+// --time-trace <file>, written on the way out
+static const char *trace_path = NULL;
+static uint64_t trace_start;
+
+
+static void write_trace(void) {
+    traceEnd("Execute", NULL, trace_start);
+    if (traceWrite(trace_path))
+        perror(trace_path);
+}
+
+
+// --stats prints the counters on stderr on the way out, --stats-json as JSON
+static bool stats_json = false;
+
+
+static void print_stats(void) {
+    statsPrint(stderr, stats_json);
+}
+
+
+static bool is_dir(const char *p_path) {
+    struct stat st;
+    return !stat(p_path, &st) && S_ISDIR(st.st_mode);
+}
+
+
+static void output_file(void *p_ctx, const DriverFile *p_file) {
+    Output *output = (Output*)p_ctx;
+    if (!p_file->tree)
+        return;
+    if (output->headers) {
+        sinkPuts(output->out, "# ");
+        sinkPuts(output->out, p_file->path);
+        sinkPutc(output->out, '\n');
+    }
+    flatTreeDump(p_file->tree, output->out, output->format);
+    // Errors of the next file go through stdio
+    sinkFlush(output->out);
+}
+
+
+/*
+ * A lone file's tree on stdout, not 0 when it could not all be written.
+*/
+static int dump_tree(const FlatTree *p_tree, DumpFormat p_format) {
+    Sink *out = sinkInit(STDOUT_FILENO, 0);
+    if (!out)
+        return -1;
+    flatTreeDump(p_tree, out, p_format);
+    return sinkTerminate(out);
+}
+
+
+/*
+ * Several files, or a directory, go through the driver: one file per task on
+ * every core, dumps in the order of the arguments. So does everything a
+ * server compiles, a lone file then prints as it would on its own.
+*/
+static int compile_files(void *p_session, char *p_paths[], int p_count, DumpFormat p_format, int p_threads) {
+    Session *session = (Session*)p_session;
+    Driver *driver = driverInit(p_threads ? p_threads : session->threads);
+    if (!driver)
+        return 1;
+    driverSetCache(driver, session->cache);
+    driverSetModules(driver, session->modules);
+    driverSetLazyBodies(driver, session->lazy_bodies);
+    int status = 0;
+    for (int i = 0; i < p_count; i++) {
+        if (driverAddPath(driver, p_paths[i])) {
+            perror(p_paths[i]);
+            status = 1;
+        }
+    }
+    bool listed = p_count > 1 || is_dir(p_paths[0]);
+    Output output = {sinkInit(STDOUT_FILENO, 0), p_format, listed};
+    if (!output.out) {
+        driverTerminate(driver);
+        return 1;
+    }
+    if (driverRun(driver, output_file, &output))
+        status = 1;
+    if (sinkTerminate(output.out))
+        status = 1;
+
+    DriverStats stats = driverGetStats(driver);
+    if (listed)
+        fprintf(stderr, "%zu files (%zu cached, %zu failed), %.1f MB in %.3f s: %.1f MB/s, %.0f files/s on %d threads\n",
+            stats.files, stats.cached, stats.failed, stats.bytes / 1e6, stats.seconds,
+            stats.bytes / 1e6 / stats.seconds, stats.files / stats.seconds, stats.threads);
+    driverTerminate(driver);
+    return status;
+}
+
+
+/*
+ * Keeps every tree in memory across requests until killed.
+*/
+static int serve(const char *p_socket, Session *p_session) {
+    p_session->modules = moduleCacheInit();
+    if (!p_session->modules)
+        abort();
+    int status = 0;
+    if (serverListen(p_socket, compile_files, p_session)) {
+        perror(p_socket);
+        status = 1;
+    }
+    moduleCacheTerminate(p_session->modules);
+    return status;
+}
+
 int main(int argc, char *argv[]) {
 
-    FILE *file = fopen(argv[1], "rb");
+    // --cache <dir> keeps the tree of every file parsed so far, up to --cache-limit <MB> of them
+    const char *cache_dir = NULL;
+    long cache_limit = -1;
+    DumpFormat format = DUMP_TEXT;
+    // --threads <n> parses the top level declarations of a file on n threads, a stream is lexed on a thread of its own.
+    // With several files it is the number of files parsed at once, one per core by default
+    int threads = 0;
+    // --serve <socket> stays up compiling for clients, --connect <socket> has such a server compile when there is one
+    const char *serve_socket = NULL;
+    const char *server_socket = NULL;
+    bool stats = false;
+    // --lazy-bodies skips method bodies while parsing, they are parsed when the tree is dumped
+    bool lazy_bodies = false;
+    int arg = 1;
+    for (; arg < argc; arg++) {
+        if (!strcmp(argv[arg], "--cache") && arg + 1 < argc)
+            cache_dir = argv[++arg];
+        else if (!strcmp(argv[arg], "--cache-limit") && arg + 1 < argc)
+            cache_limit = atol(argv[++arg]);
+        else if (!strcmp(argv[arg], "--threads") && arg + 1 < argc)
+            threads = atoi(argv[++arg]);
+        else if (!strcmp(argv[arg], "--compact"))
+            format = DUMP_COMPACT;
+        else if (!strcmp(argv[arg], "--serve") && arg + 1 < argc)
+            serve_socket = argv[++arg];
+        else if (!strcmp(argv[arg], "--connect") && arg + 1 < argc)
+            server_socket = argv[++arg];
+        else if (!strcmp(argv[arg], "--time-trace") && arg + 1 < argc)
+            trace_path = argv[++arg];
+        else if (!strcmp(argv[arg], "--stats"))
+            stats = true;
+        else if (!strcmp(argv[arg], "--stats-json"))
+            stats = stats_json = true;
+        else if (!strcmp(argv[arg], "--lazy-bodies"))
+            lazy_bodies = true;
+        else
+            break;
+    }
+    if (!serve_socket && arg >= argc) {
+        fprintf(stderr, "usage: %s [--cache <dir>] [--cache-limit <MB>] [--threads <n>] [--compact] [--time-trace <file>] [--stats | --stats-json] [--lazy-bodies] [--connect <socket>] <file | dir | ->...\n"
+            "       %s [--cache <dir>] [--cache-limit <MB>] [--threads <n>] [--time-trace <file>] [--stats | --stats-json] [--lazy-bodies] --serve <socket>\n", argv[0], argv[0]);
+        return 1;
+    }
+    const char *path = arg < argc ? argv[arg] : NULL;
+    int server_status;
+    if (server_socket && path && strcmp(path, "-") && !serverSubmit(server_socket, argv + arg, argc - arg, format, threads, &server_status))
+        return server_status;
 
-    // Init the tokenizer
-    Tokenizer *tk = tokenizerInit(get_char, (void*)file, argv[1]);
+    // Chrome trace JSON of where the time went, for chrome://tracing or Perfetto
+    if (trace_path) {
+        traceStart();
+        traceNameThread("Main");
+        trace_start = traceBegin();
+        atexit(write_trace);
+    }
+    if (stats) {
+        statsStart();
+        atexit(print_stats);
+    }
+
+    // Nothing given changes what a text parses to, no flags go into the keys
+    TreeCache *cache = NULL;
+    if (cache_dir) {
+        cache = treeCacheInit(cache_dir, NULL);
+        if (!cache)
+            perror(cache_dir);
+        else if (cache_limit >= 0)
+            treeCacheSetLimit(cache, (uint64_t)cache_limit << 20);
+    }
+    Session session = {cache, NULL, threads, lazy_bodies};
+    if (serve_socket || arg < argc - 1 || is_dir(path)) {
+        int status = serve_socket ? serve(serve_socket, &session)
+            : compile_files(&session, argv + arg, argc - arg, format, threads);
+        if (cache)
+            treeCacheTerminate(cache);
+        return status;
+    }
+
+    // Init the tokenizer, streams fall back to the per-character callback
+    Tokenizer *tk;
+    if (!strcmp(path, "-"))
+        tk = tokenizerInit(get_char, (void*)stdin, "<stdin>");
+    else
+        tk = tokenizerInitFile(path);
+    if (!tk) {
+        perror(path);
+        if (cache)
+            treeCacheTerminate(cache);
+        return 1;
+    }
+
+    // A cached tree of the very same text stands in for the whole frontend
+    uint64_t key = 0;
+    size_t size;
+    const char *source = tokenizerGetBuffer(tk, &size);
+    if (cache && source) {
+        key = treeCacheKey(source, size);
+        FlatTree *tree = treeCacheLoad(cache, key, size);
+        if (tree) {
+            int status = dump_tree(tree, format);
+            flatTreeTerminate(tree);
+            treeCacheTerminate(cache);
+            tokenizerTerminate(tk);
+            return status ? 1 : 0;
+        }
+    }
+
+    // Whole files are lexed up front into the token array, or piece by piece by every thread.
+    // Skipped bodies are skipped on the text, lexing them first would undo the saving
+    if (strcmp(path, "-") && threads < 2 && !lazy_bodies)
+        tokenizerLexAll(tk);
+    // Streams are lexed on a thread of their own ahead of the parser
+    if (!strcmp(path, "-") && threads > 1)
+        tokenizerStartLexerThread(tk);
     
     Parser *pr = parserInit(tk);
+    parserSetThreads(pr, threads);
+    parserSetLazyBodies(pr, lazy_bodies);
 
-    parserParse(pr);
+    int status = parserParse(pr);
+    if (!status) {
+        FlatTree *tree = nodeFlatten(parserGetRoot(pr));
+        // A skipped body that failed fails the file, its tree is not to be kept
+        if (parserGetBodyErrors(pr)) {
+            status = -1;
+        } else {
+            status = dump_tree(tree, format);
+            if (cache && source && treeCacheStore(cache, key, size, tree))
+                perror(cache_dir);
+        }
+        flatTreeTerminate(tree);
+    }
+    if (cache)
+        treeCacheTerminate(cache);
 
     parserTerminate(pr);
 
@@ -35,10 +298,13 @@ int main(int argc, char *argv[]) {
                 Literal *lt = tokenizerTokenGetLiteral(t);
                 switch (literalGetType(lt)) {
                     case LT_INT:
-                        printf("int: %d\n", *(int*)literalGetVal(lt));
+                        printf("int: %lld\n", (long long)*(int64_t*)literalGetVal(lt));
+                        break;
+                    case LT_UINT:
+                        printf("uint: %llu\n", (unsigned long long)*(uint64_t*)literalGetVal(lt));
                         break;
                     case LT_FLOAT:
-                        printf("float: %f\n", *(float*)literalGetVal(lt));
+                        printf("float: %f\n", *(double*)literalGetVal(lt));
                         break;
                     case LT_STRING:
                         printf("string: %s\n", (char*)literalGetVal(lt));
@@ -54,5 +320,5 @@ int main(int argc, char *argv[]) {
     
     tokenizerTerminate(tk);
 
-    return 0;
+    return status ? 1 : 0;
 }
@@ -0,0 +1,776 @@
+#define _POSIX_C_SOURCE 200809L
+#include "flat_tree.h"
+#include "syntax_tree.h"
+#include "../extra/sink.h"
+#include "../extra/trace.h"
+
+#include <assert.h>
+#include <fcntl.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#define INITIAL_CAPACITY 64
+#define FLAT_MAGIC "RAST"
+#define FLAT_ALIGN 8
+
+
+/*
+ * A literal packed to 16 bytes. Strings are kept as an offset into the
+ * string table so it can grow: the raw text, then its decoded form right
+ * after, both null terminated. The pointers are only made on the way out.
+*/
+typedef struct {
+    uint8_t type;
+    uint8_t suffix;
+    uint32_t length;
+    union {
+        int64_t i;
+        uint64_t u;
+        double f;
+        uint64_t offset;
+    };
+} FlatLiteral;
+
+
+typedef struct {
+    uint32_t offset;
+    uint32_t length;
+} FlatSymbol;
+
+
+/*
+ * The file is the header then every table, each one 8 byte aligned and
+ * found through its offset from the start of the file, so a mapping of it
+ * is a tree as is wherever it lands. Integers are stored in the byte order
+ * of the host, a foreign file fails on its version.
+*/
+typedef struct {
+    char magic[4];
+    uint32_t version;
+    uint64_t source_hash;
+    // Checked along with the hash, which alone may collide
+    uint64_t source_size;
+    uint64_t file_size;
+    uint32_t node_count;
+    uint32_t literal_count;
+    uint32_t symbol_count;
+    uint32_t string_size;
+    uint64_t nodes;
+    uint64_t literals;
+    uint64_t symbols;
+    uint64_t strings;
+} FlatHeader;
+
+
+struct FlatTree {
+    FlatNode *nodes;
+    size_t count;
+    size_t capacity;
+    FlatLiteral *literals;
+    size_t literal_count;
+    size_t literal_capacity;
+    FlatSymbol *symbols;
+    size_t symbol_count;
+    size_t symbol_capacity;
+    char *strings;
+    size_t string_size;
+    size_t string_capacity;
+    // Set when the tables live in a mapped file, such a tree is read only
+    void *mapping;
+    size_t mapping_size;
+};
+
+
+static void *_grow(void *p_array, size_t *p_capacity, size_t p_needed, size_t p_size) {
+    if (p_needed <= *p_capacity)
+        return p_array;
+    size_t capacity = *p_capacity ? *p_capacity : INITIAL_CAPACITY;
+    while (capacity < p_needed)
+        capacity *= 2;
+    void *array = realloc(p_array, capacity * p_size);
+    if (!array)
+        abort();
+    *p_capacity = capacity;
+    return array;
+}
+
+
+static uint32_t _add_string(FlatTree *p_tree, size_t p_length) {
+    uint32_t offset = (uint32_t)p_tree->string_size;
+    p_tree->strings = (char*)_grow(p_tree->strings, &p_tree->string_capacity, p_tree->string_size + p_length + 1, 1);
+    p_tree->string_size += p_length + 1;
+    return offset;
+}
+
+
+FlatTree *flatTreeInit(size_t p_capacity) {
+    FlatTree *tree = (FlatTree*)calloc(1, sizeof(FlatTree));
+    if (!tree)
+        return NULL;
+    tree->nodes = (FlatNode*)_grow(NULL, &tree->capacity, p_capacity ? p_capacity : 1, sizeof(FlatNode));
+    return tree;
+}
+
+
+FlatIndex flatTreeReserve(FlatTree *p_tree, uint32_t p_count) {
+    assert(!p_tree->mapping);
+    FlatIndex first = (FlatIndex)p_tree->count;
+    p_tree->nodes = (FlatNode*)_grow(p_tree->nodes, &p_tree->capacity, p_tree->count + p_count, sizeof(FlatNode));
+    memset(p_tree->nodes + first, 0, p_count * sizeof(FlatNode));
+    p_tree->count += p_count;
+    return first;
+}
+
+
+uint32_t flatTreeAddLiteral(FlatTree *p_tree, const Literal *p_literal) {
+    assert(!p_tree->mapping);
+    p_tree->literals = (FlatLiteral*)_grow(p_tree->literals, &p_tree->literal_capacity,
+        p_tree->literal_count + 1, sizeof(FlatLiteral));
+    FlatLiteral *lt = &p_tree->literals[p_tree->literal_count];
+    *lt = (FlatLiteral){.type = (uint8_t)p_literal->type, .suffix = (uint8_t)p_literal->suffix};
+    switch (p_literal->type) {
+        case LT_INT:
+            lt->i = p_literal->i;
+            break;
+        case LT_UINT:
+            lt->u = p_literal->u;
+            break;
+        case LT_FLOAT:
+            lt->f = p_literal->f;
+            break;
+        case LT_STRING: {
+            size_t length = p_literal->str.raw_length;
+            lt->length = (uint32_t)length;
+            lt->offset = _add_string(p_tree, length);
+            memcpy(p_tree->strings + lt->offset, p_literal->str.raw, length);
+            p_tree->strings[lt->offset + length] = '\0';
+            // Decoding never grows the text, only what it used is kept
+            _add_string(p_tree, length);
+            size_t decoded = literalStringDecode(p_literal->str.raw, length, p_tree->strings + lt->offset + length + 1);
+            p_tree->string_size -= length - decoded;
+            break;
+        }
+    }
+    return (uint32_t)p_tree->literal_count++;
+}
+
+
+uint32_t flatTreeAddSymbol(FlatTree *p_tree, const char *p_name, size_t p_length) {
+    assert(!p_tree->mapping);
+    p_tree->symbols = (FlatSymbol*)_grow(p_tree->symbols, &p_tree->symbol_capacity,
+        p_tree->symbol_count + 1, sizeof(FlatSymbol));
+    FlatSymbol *symbol = &p_tree->symbols[p_tree->symbol_count];
+    symbol->offset = _add_string(p_tree, p_length);
+    symbol->length = (uint32_t)p_length;
+    memcpy(p_tree->strings + symbol->offset, p_name, p_length);
+    p_tree->strings[symbol->offset + p_length] = '\0';
+    return (uint32_t)p_tree->symbol_count++;
+}
+
+
+static size_t _align(size_t p_offset) {
+    return (p_offset + FLAT_ALIGN - 1) & ~(size_t)(FLAT_ALIGN - 1);
+}
+
+
+static bool _write_table(FILE *p_file, size_t *p_offset, const void *p_table, size_t p_size) {
+    static const char padding[FLAT_ALIGN];
+    size_t pad = _align(*p_offset) - *p_offset;
+    if (fwrite(padding, 1, pad, p_file) != pad || (p_size && fwrite(p_table, 1, p_size, p_file) != p_size))
+        return false;
+    *p_offset += pad + p_size;
+    return true;
+}
+
+
+int flatTreeSave(const FlatTree *p_tree, const char *p_path, uint64_t p_source_hash, uint64_t p_source_size) {
+    FlatHeader header = {
+        .magic = FLAT_MAGIC,
+        .version = FLAT_TREE_VERSION,
+        .source_hash = p_source_hash,
+        .source_size = p_source_size,
+        .node_count = (uint32_t)p_tree->count,
+        .literal_count = (uint32_t)p_tree->literal_count,
+        .symbol_count = (uint32_t)p_tree->symbol_count,
+        .string_size = (uint32_t)p_tree->string_size
+    };
+    header.nodes = _align(sizeof(FlatHeader));
+    header.literals = _align(header.nodes + p_tree->count * sizeof(FlatNode));
+    header.symbols = _align(header.literals + p_tree->literal_count * sizeof(FlatLiteral));
+    header.strings = _align(header.symbols + p_tree->symbol_count * sizeof(FlatSymbol));
+    header.file_size = header.strings + p_tree->string_size;
+
+    // Written aside then renamed over, readers never see half a file. The
+    // name is unique to this writer, threads and processes storing the same
+    // tree at once each rename a whole file of their own
+    size_t length = strlen(p_path);
+    char *temp = (char*)malloc(length + sizeof(FLAT_TEMP_SUFFIX));
+    if (!temp)
+        return -1;
+    memcpy(temp, p_path, length);
+    memcpy(temp + length, FLAT_TEMP_SUFFIX, sizeof(FLAT_TEMP_SUFFIX));
+    int fd = mkstemp(temp);
+    FILE *file = fd < 0 ? NULL : fdopen(fd, "wb");
+    if (!file) {
+        if (fd >= 0) {
+            close(fd);
+            unlink(temp);
+        }
+        free(temp);
+        return -1;
+    }
+    // mkstemp makes it private, a saved tree is for every build to read
+    fchmod(fd, 0644);
+    size_t offset = 0;
+    bool ok = _write_table(file, &offset, &header, sizeof(FlatHeader))
+        && _write_table(file, &offset, p_tree->nodes, p_tree->count * sizeof(FlatNode))
+        && _write_table(file, &offset, p_tree->literals, p_tree->literal_count * sizeof(FlatLiteral))
+        && _write_table(file, &offset, p_tree->symbols, p_tree->symbol_count * sizeof(FlatSymbol))
+        && _write_table(file, &offset, p_tree->strings, p_tree->string_size);
+    ok = !fclose(file) && ok && !rename(temp, p_path);
+    if (!ok)
+        unlink(temp);
+    free(temp);
+    return ok ? 0 : -1;
+}
+
+
+static bool _table_fits(const FlatHeader *p_header, uint64_t p_offset, uint64_t p_size) {
+    return p_offset % FLAT_ALIGN == 0 && p_offset >= sizeof(FlatHeader)
+        && p_offset <= p_header->file_size && p_size <= p_header->file_size - p_offset;
+}
+
+
+/*
+ * Whether p_length bytes at p_offset of the string table end with a NUL,
+ * p_length of UINT64_MAX meaning wherever the first NUL is.
+*/
+static bool _string_fits(const FlatTree *p_tree, uint64_t p_offset, uint64_t p_length) {
+    if (p_offset >= p_tree->string_size)
+        return false;
+    uint64_t room = p_tree->string_size - p_offset;
+    if (p_length == UINT64_MAX)
+        return memchr(p_tree->strings + p_offset, '\0', room) != NULL;
+    return p_length < room && p_tree->strings[p_offset + p_length] == '\0';
+}
+
+
+/*
+ * Whether every child of p_node has one of the kinds p_kinds allows, a bit
+ * per NodeType.
+*/
+static bool _children_are(const FlatTree *p_tree, const FlatNode *p_node, uint32_t p_kinds) {
+    for (uint32_t i = 0; i < p_node->child_count; i++) {
+        // Children come after their parent, not checked on their own yet
+        uint8_t kind = p_tree->nodes[p_node->first_child + i].kind;
+        if (kind > NODE_BINARY || !(p_kinds & 1u << kind))
+            return false;
+    }
+    return true;
+}
+
+
+#define KIND(K) (1u << (K))
+#define EXPRESSIONS (KIND(NODE_IDENTIFIER) | KIND(NODE_LITERAL) | KIND(NODE_UNARY) | KIND(NODE_BINARY))
+#define STATEMENTS (~(KIND(NODE_PARAM) | KIND(NODE_PARAMLIST)))
+
+
+/*
+ * A mapped file is checked as strictly as the dumper and the accessors
+ * need it: every index within its table, every string terminated, every
+ * node shaped as nodeFlatten makes it, and the nodes a tree, each below
+ * its parent and the child of one parent only, so no walk goes out of
+ * bounds or around in circles.
+*/
+static bool _valid_tree(const FlatTree *p_tree) {
+    for (size_t i = 0; i < p_tree->symbol_count; i++)
+        if (!_string_fits(p_tree, p_tree->symbols[i].offset, p_tree->symbols[i].length))
+            return false;
+    for (size_t i = 0; i < p_tree->literal_count; i++) {
+        const FlatLiteral *lt = &p_tree->literals[i];
+        if (lt->type > LT_STRING || lt->suffix > LS_F64)
+            return false;
+        // The raw text, then its decoded form
+        if (lt->type == LT_STRING && (!_string_fits(p_tree, lt->offset, lt->length)
+                || !_string_fits(p_tree, (uint64_t)lt->offset + lt->length + 1, UINT64_MAX)))
+            return false;
+    }
+
+    bool *claimed = (bool*)calloc(p_tree->count ? p_tree->count : 1, sizeof(bool));
+    if (!claimed)
+        abort();
+    bool valid = true;
+    for (size_t i = 0; i < p_tree->count && valid; i++) {
+        const FlatNode *node = &p_tree->nodes[i];
+        if (node->kind > NODE_BINARY) {
+            valid = false;
+            break;
+        }
+        if (node->child_count) {
+            if (node->first_child <= i || node->first_child >= p_tree->count
+                    || node->child_count > p_tree->count - node->first_child) {
+                valid = false;
+                break;
+            }
+            for (uint32_t c = 0; c < node->child_count && valid; c++) {
+                valid = !claimed[node->first_child + c];
+                claimed[node->first_child + c] = true;
+            }
+            if (!valid)
+                break;
+        }
+        switch (node->kind) {
+            case NODE_IDENTIFIER:
+                valid = !node->child_count && node->data < p_tree->symbol_count;
+                break;
+            case NODE_LITERAL:
+                valid = !node->child_count && node->data < p_tree->literal_count;
+                break;
+            case NODE_TYPE:
+                valid = !node->child_count;
+                break;
+            case NODE_SPACE:
+            case NODE_SCOPE:
+                valid = _children_are(p_tree, node, STATEMENTS);
+                break;
+            case NODE_PARAMLIST:
+                valid = _children_are(p_tree, node, KIND(NODE_PARAM));
+                break;
+            case NODE_PARAM:
+                valid = node->child_count <= 1 && _children_are(p_tree, node, KIND(NODE_TYPE));
+                break;
+            case NODE_LET:
+                valid = (node->child_count == 1 || node->child_count == 2)
+                    && p_tree->nodes[node->first_child].kind == NODE_IDENTIFIER
+                    && _children_are(p_tree, node, STATEMENTS);
+                break;
+            case NODE_METHOD: {
+                // Present children come in params, type, scope order
+                static const uint8_t kinds[] = {NODE_PARAMLIST, NODE_TYPE, NODE_SCOPE};
+                valid = !(node->flags & ~(FLAT_METHOD_PARAMS | FLAT_METHOD_TYPE | FLAT_METHOD_SCOPE));
+                uint32_t child = 0;
+                for (int bit = 0; bit < 3 && valid; bit++) {
+                    if (!(node->flags & 1u << bit))
+                        continue;
+                    valid = child < node->child_count && p_tree->nodes[node->first_child + child].kind == kinds[bit];
+                    child++;
+                }
+                valid = valid && child == node->child_count;
+                break;
+            }
+            case NODE_UNARY:
+                valid = node->child_count == 1 && node->op <= TK_EOF && _children_are(p_tree, node, EXPRESSIONS);
+                break;
+            case NODE_BINARY:
+                valid = node->child_count == 2 && node->op <= TK_EOF && _children_are(p_tree, node, EXPRESSIONS);
+                break;
+        }
+    }
+    free(claimed);
+    return valid;
+}
+
+#undef KIND
+#undef EXPRESSIONS
+#undef STATEMENTS
+
+
+FlatTree *flatTreeMap(const char *p_path, uint64_t p_source_hash, uint64_t p_source_size) {
+    int fd = open(p_path, O_RDONLY);
+    if (fd < 0)
+        return NULL;
+    struct stat st;
+    void *map = MAP_FAILED;
+    if (fstat(fd, &st) == 0 && (size_t)st.st_size >= sizeof(FlatHeader))
+        map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED)
+        return NULL;
+
+    // The directory may be shared, anything off is a miss rather than trusted
+    const FlatHeader *header = (const FlatHeader*)map;
+    FlatTree *tree = NULL;
+    if (!memcmp(header->magic, FLAT_MAGIC, 4) && header->version == FLAT_TREE_VERSION
+        && header->source_hash == p_source_hash && header->source_size == p_source_size
+        && header->file_size == (uint64_t)st.st_size
+        && _table_fits(header, header->nodes, (uint64_t)header->node_count * sizeof(FlatNode))
+        && _table_fits(header, header->literals, (uint64_t)header->literal_count * sizeof(FlatLiteral))
+        && _table_fits(header, header->symbols, (uint64_t)header->symbol_count * sizeof(FlatSymbol))
+        && _table_fits(header, header->strings, header->string_size))
+        tree = (FlatTree*)calloc(1, sizeof(FlatTree));
+    if (!tree) {
+        munmap(map, st.st_size);
+        return NULL;
+    }
+    char *base = (char*)map;
+    *tree = (FlatTree){
+        .nodes = (FlatNode*)(base + header->nodes),
+        .count = header->node_count,
+        .capacity = header->node_count,
+        .literals = (FlatLiteral*)(base + header->literals),
+        .literal_count = header->literal_count,
+        .literal_capacity = header->literal_count,
+        .symbols = (FlatSymbol*)(base + header->symbols),
+        .symbol_count = header->symbol_count,
+        .symbol_capacity = header->symbol_count,
+        .strings = base + header->strings,
+        .string_size = header->string_size,
+        .string_capacity = header->string_size,
+        .mapping = map,
+        .mapping_size = st.st_size
+    };
+    if (!_valid_tree(tree)) {
+        flatTreeTerminate(tree);
+        return NULL;
+    }
+    return tree;
+}
+
+
+void flatTreeTerminate(FlatTree *p_tree) {
+    if (p_tree->mapping) {
+        munmap(p_tree->mapping, p_tree->mapping_size);
+    } else {
+        free(p_tree->nodes);
+        free(p_tree->literals);
+        free(p_tree->symbols);
+        free(p_tree->strings);
+    }
+    free(p_tree);
+}
+
+
+size_t flatTreeGetCount(const FlatTree *p_tree) {
+    return p_tree->count;
+}
+
+
+size_t flatTreeGetBytes(const FlatTree *p_tree) {
+    return p_tree->count * sizeof(FlatNode) + p_tree->literal_count * sizeof(FlatLiteral)
+        + p_tree->symbol_count * sizeof(FlatSymbol) + p_tree->string_size;
+}
+
+
+FlatNode *flatTreeGetNode(const FlatTree *p_tree, FlatIndex p_index) {
+    assert(p_index < p_tree->count);
+    return &p_tree->nodes[p_index];
+}
+
+
+FlatIndex flatTreeGetChild(const FlatTree *p_tree, FlatIndex p_index, uint32_t p_child) {
+    const FlatNode *node = flatTreeGetNode(p_tree, p_index);
+    return p_child < node->child_count ? node->first_child + p_child : FLAT_NONE;
+}
+
+
+Literal flatTreeGetLiteral(const FlatTree *p_tree, uint32_t p_index) {
+    assert(p_index < p_tree->literal_count);
+    const FlatLiteral *lt = &p_tree->literals[p_index];
+    Literal literal = {.type = (LiteralType)lt->type, .suffix = (LiteralSuffix)lt->suffix};
+    switch (literal.type) {
+        case LT_INT:
+            literal.i = lt->i;
+            break;
+        case LT_UINT:
+            literal.u = lt->u;
+            break;
+        case LT_FLOAT:
+            literal.f = lt->f;
+            break;
+        case LT_STRING:
+            literal.str.raw = p_tree->strings + lt->offset;
+            literal.str.raw_length = lt->length;
+            literal.str.decoded = p_tree->strings + lt->offset + lt->length + 1;
+            break;
+    }
+    return literal;
+}
+
+
+const char *flatTreeGetSymbol(const FlatTree *p_tree, uint32_t p_index) {
+    assert(p_index < p_tree->symbol_count);
+    return p_tree->strings + p_tree->symbols[p_index].offset;
+}
+
+
+
+/*
+ * Both formats are written by a loop over an explicit stack, a dump keeps
+ * no state outside of its own call and deep trees cost no C stack. A frame
+ * counts the steps its node has been through.
+*/
+typedef struct {
+    FlatIndex index;
+    uint32_t step;
+    // Written inline, as part of the enclosing expression
+    bool inline_expression;
+} DumpFrame;
+
+
+typedef struct {
+    const FlatTree *tree;
+    Sink *sink;
+    DumpFrame *frames;
+    size_t depth;
+    size_t capacity;
+} Dumper;
+
+
+static const char *compact_names[] = {
+    [NODE_IDENTIFIER] = "id",
+    [NODE_TYPE] = "type",
+    [NODE_SPACE] = "space",
+    [NODE_SCOPE] = "scope",
+    [NODE_LET] = "let",
+    [NODE_METHOD] = "method",
+    [NODE_PARAM] = "param",
+    [NODE_PARAMLIST] = "params",
+    [NODE_LITERAL] = "lit",
+    [NODE_UNARY] = "unary",
+    [NODE_BINARY] = "binary",
+};
+
+
+static void _dump_push(Dumper *p_dumper, FlatIndex p_index, bool p_inline) {
+    if (p_dumper->depth == p_dumper->capacity)
+        p_dumper->frames = (DumpFrame*)_grow(p_dumper->frames, &p_dumper->capacity, p_dumper->depth + 1, sizeof(DumpFrame));
+    p_dumper->frames[p_dumper->depth++] = (DumpFrame){p_index, 0, p_inline};
+}
+
+
+static void _dump_indent(Sink *p_sink, int p_indent) {
+    sinkRepeat(p_sink, ' ', 2 * p_indent);
+}
+
+
+static void _dump_literal(Sink *p_sink, const Literal *p_literal, bool p_exact) {
+    switch (p_literal->type) {
+        case LT_INT:
+            sinkInt(p_sink, p_literal->i);
+            break;
+        case LT_UINT:
+            sinkUInt(p_sink, p_literal->u);
+            break;
+        case LT_FLOAT:
+            sinkPrintf(p_sink, p_exact ? "%.17g" : "%g", p_literal->f);
+            break;
+        case LT_STRING:
+            sinkPutc(p_sink, '"');
+            sinkWrite(p_sink, p_literal->str.raw, p_literal->str.raw_length);
+            sinkPutc(p_sink, '"');
+            break;
+    }
+    sinkPuts(p_sink, literalSuffixName(p_literal->suffix));
+}
+
+
+/*
+ * The text nodeExpose used to print: lists are written from their last
+ * child, parameters are left out.
+*/
+static void _dump_text(Dumper *p_dumper) {
+    const FlatTree *tree = p_dumper->tree;
+    Sink *sink = p_dumper->sink;
+    int indent = 0;
+    while (p_dumper->depth) {
+        DumpFrame *frame = &p_dumper->frames[p_dumper->depth - 1];
+        const FlatNode *node = &tree->nodes[frame->index];
+        const FlatNode *children = node->child_count ? &tree->nodes[node->first_child] : NULL;
+        uint32_t step = frame->step++;
+
+        if (!frame->inline_expression) {
+            switch (node->kind) {
+                case NODE_SPACE:
+                case NODE_SCOPE: {
+                    const char *name = node->kind == NODE_SPACE ? "space" : "scope";
+                    if (!step) {
+                        sinkPutc(sink, '\n');
+                        _dump_indent(sink, indent++);
+                        sinkPuts(sink, name);
+                        sinkWrite(sink, " {\n", 3);
+                    }
+                    if (step < node->child_count) {
+                        _dump_push(p_dumper, node->first_child + node->child_count - 1 - step, false);
+                        continue;
+                    }
+                    _dump_indent(sink, --indent);
+                    sinkWrite(sink, "} #", 3);
+                    sinkPuts(sink, name);
+                    sinkWrite(sink, "\n\n", 2);
+                    break;
+                }
+                case NODE_LET: {
+                    const char *name = flatTreeGetSymbol(tree, children[0].data);
+                    if (node->child_count < 2) {
+                        sinkPutc(sink, '\n');
+                        _dump_indent(sink, indent);
+                        sinkWrite(sink, "let ", 4);
+                        sinkPuts(sink, name);
+                        sinkPutc(sink, '\n');
+                        break;
+                    }
+                    if (!step) {
+                        _dump_indent(sink, indent++);
+                        sinkWrite(sink, "let ", 4);
+                        sinkPuts(sink, name);
+                        sinkWrite(sink, " {\n", 3);
+                        _dump_push(p_dumper, node->first_child + 1, false);
+                        continue;
+                    }
+                    _dump_indent(sink, --indent);
+                    sinkWrite(sink, "} #let\n\n", 8);
+                    break;
+                }
+                case NODE_METHOD: {
+                    if (!step) {
+                        sinkPutc(sink, '\n');
+                        _dump_indent(sink, indent++);
+                        // Present children come in params, type, scope order
+                        uint32_t child = node->flags & FLAT_METHOD_PARAMS ? 1 : 0;
+                        if (node->flags & FLAT_METHOD_TYPE) {
+                            sinkWrite(sink, "method ", 7);
+                            sinkUInt(sink, children[child++].data);
+                            sinkWrite(sink, " {", 2);
+                        } else {
+                            sinkWrite(sink, "method {\n", 9);
+                        }
+                        if (node->flags & FLAT_METHOD_SCOPE)
+                            _dump_push(p_dumper, node->first_child + child, false);
+                        continue;
+                    }
+                    _dump_indent(sink, --indent);
+                    sinkWrite(sink, "} #method\n\n", 11);
+                    break;
+                }
+                case NODE_TYPE:
+                    _dump_indent(sink, indent);
+                    sinkWrite(sink, "type: ", 6);
+                    sinkUInt(sink, node->data);
+                    sinkPutc(sink, '\n');
+                    break;
+                default:
+                    // An expression on a line of its own
+                    if (!step) {
+                        _dump_indent(sink, indent);
+                        _dump_push(p_dumper, frame->index, true);
+                        continue;
+                    }
+                    sinkPutc(sink, '\n');
+                    break;
+            }
+            p_dumper->depth--;
+            continue;
+        }
+
+        switch (node->kind) {
+            case NODE_IDENTIFIER:
+                sinkPuts(sink, flatTreeGetSymbol(tree, node->data));
+                break;
+            case NODE_LITERAL: {
+                Literal literal = flatTreeGetLiteral(tree, node->data);
+                _dump_literal(sink, &literal, false);
+                break;
+            }
+            case NODE_UNARY:
+                if (!step) {
+                    sinkPutc(sink, '(');
+                    sinkPuts(sink, tokenizerTokenTypeName(node->op));
+                    sinkPutc(sink, ' ');
+                    _dump_push(p_dumper, node->first_child, true);
+                    continue;
+                }
+                sinkPutc(sink, ')');
+                break;
+            case NODE_BINARY:
+                if (step < 2) {
+                    if (step) {
+                        sinkPutc(sink, ' ');
+                        sinkPuts(sink, tokenizerTokenTypeName(node->op));
+                        sinkPutc(sink, ' ');
+                    } else {
+                        sinkPutc(sink, '(');
+                    }
+                    _dump_push(p_dumper, node->first_child + step, true);
+                    continue;
+                }
+                sinkPutc(sink, ')');
+                break;
+            default:
+                assert(0);
+        }
+        p_dumper->depth--;
+    }
+}
+
+
+/*
+ * One line per node, depth first with children in source order:
+ * "<kind> <child count>" then what the node holds beside its children.
+*/
+static void _dump_compact(Dumper *p_dumper) {
+    const FlatTree *tree = p_dumper->tree;
+    Sink *sink = p_dumper->sink;
+    while (p_dumper->depth) {
+        DumpFrame *frame = &p_dumper->frames[p_dumper->depth - 1];
+        const FlatNode *node = &tree->nodes[frame->index];
+        uint32_t step = frame->step++;
+        if (!step) {
+            sinkPuts(sink, compact_names[node->kind]);
+            sinkPutc(sink, ' ');
+            sinkUInt(sink, node->child_count);
+            switch (node->kind) {
+                case NODE_IDENTIFIER:
+                    sinkPutc(sink, ' ');
+                    sinkPuts(sink, flatTreeGetSymbol(tree, node->data));
+                    break;
+                case NODE_TYPE:
+                    sinkPutc(sink, ' ');
+                    sinkUInt(sink, node->data);
+                    break;
+                case NODE_METHOD:
+                    sinkPutc(sink, ' ');
+                    sinkUInt(sink, node->flags);
+                    break;
+                case NODE_LITERAL: {
+                    Literal literal = flatTreeGetLiteral(tree, node->data);
+                    sinkPutc(sink, ' ');
+                    _dump_literal(sink, &literal, true);
+                    break;
+                }
+                case NODE_UNARY:
+                case NODE_BINARY:
+                    sinkPutc(sink, ' ');
+                    sinkPuts(sink, tokenizerTokenTypeName(node->op));
+                    break;
+                default:
+                    break;
+            }
+            sinkPutc(sink, '\n');
+        }
+        if (step < node->child_count) {
+            _dump_push(p_dumper, node->first_child + step, false);
+            continue;
+        }
+        p_dumper->depth--;
+    }
+}
+
+
+void flatTreeDump(const FlatTree *p_tree, Sink *p_sink, DumpFormat p_format) {
+    if (!p_tree->count)
+        return;
+    uint64_t start = traceBegin();
+    Dumper dumper = {.tree = p_tree, .sink = p_sink};
+    _dump_push(&dumper, 0, false);
+    if (p_format == DUMP_COMPACT)
+        _dump_compact(&dumper);
+    else
+        _dump_text(&dumper);
+    free(dumper.frames);
+    traceEnd("Dump", NULL, start);
+}
@@ -0,0 +1,66 @@
+#ifndef FLAT_TREE_H
+#define FLAT_TREE_H
+
+#include "../frontend/literal.h"
+#include "../extra/sink.h"
+
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * The syntax tree as one array of fixed size nodes addressed by index.
+ * The children of a node are always contiguous and in source order; what does not fit a node lives in side
+ * tables. Nothing in it is a pointer, so it is saved as is and a mapping of
+ * the file is used in place.
+*/
+
+#define FLAT_NONE UINT32_MAX
+// Bumped whenever the saved layout changes, older files are then ignored
+#define FLAT_TREE_VERSION 2
+// Appended to the path of a tree being saved, the X are made unique
+#define FLAT_TEMP_SUFFIX ".tmp.XXXXXX"
+
+// Which of the optional children of a method are present, in this order
+#define FLAT_METHOD_PARAMS 0x1
+#define FLAT_METHOD_TYPE 0x2
+#define FLAT_METHOD_SCOPE 0x4
+
+typedef uint32_t FlatIndex;
+
+typedef struct {
+    uint8_t kind;           // NodeType
+    uint8_t op;             // TokenType of unary and binary expressions
+    uint16_t flags;
+    FlatIndex first_child;
+    uint32_t child_count;
+    // Symbol table index of identifiers, TypeType of types, literal table index of literals
+    uint32_t data;
+} FlatNode;
+
+typedef enum {
+    // What nodeExpose printed, for people
+    DUMP_TEXT,
+    // One line per node in source order, for tools
+    DUMP_COMPACT,
+} DumpFormat;
+
+typedef struct FlatTree FlatTree;
+
+
+FlatTree *flatTreeInit(size_t p_capacity);
+FlatIndex flatTreeReserve(FlatTree *p_tree, uint32_t p_count);
+uint32_t flatTreeAddLiteral(FlatTree *p_tree, const Literal *p_literal);
+uint32_t flatTreeAddSymbol(FlatTree *p_tree, const char *p_name, size_t p_length);
+int flatTreeSave(const FlatTree *p_tree, const char *p_path, uint64_t p_source_hash, uint64_t p_source_size);
+FlatTree *flatTreeMap(const char *p_path, uint64_t p_source_hash, uint64_t p_source_size);
+void flatTreeTerminate(FlatTree *p_tree);
+
+size_t flatTreeGetCount(const FlatTree *p_tree);
+size_t flatTreeGetBytes(const FlatTree *p_tree);
+FlatNode *flatTreeGetNode(const FlatTree *p_tree, FlatIndex p_index);
+FlatIndex flatTreeGetChild(const FlatTree *p_tree, FlatIndex p_index, uint32_t p_child);
+Literal flatTreeGetLiteral(const FlatTree *p_tree, uint32_t p_index);
+const char *flatTreeGetSymbol(const FlatTree *p_tree, uint32_t p_index);
+void flatTreeDump(const FlatTree *p_tree, Sink *p_sink, DumpFormat p_format);
+
+#endif // FLAT_TREE_H
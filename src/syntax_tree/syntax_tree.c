@@ -4,10 +4,14 @@
 #include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <assert.h>
-#include "../extra/hash.h"
+#include "../extra/interner.h"
+#include "../extra/stats.h"
+#include "../extra/trace.h"
 
-#define ALLOC(T) (T*)malloc(sizeof(T))
+#define ALLOC(T) (T*)arenaAlloc(p_arena, sizeof(T))
+#define ALLOC_NODE(T) (STATS_ADD(STAT_NODES, 1), STATS_ADD(STAT_NODE_BYTES, sizeof(T)), ALLOC(T))
 
 
 typedef struct LinkedList LinkedList;
@@ -17,8 +21,10 @@ struct LinkedList {
 };
 
 
-LinkedList *linkedListCreate(LinkedList *p_previous, void *p_value) {
+LinkedList *linkedListCreate(Arena *p_arena, LinkedList *p_previous, void *p_value) {
     LinkedList *ll = ALLOC(LinkedList);
+    STATS_ADD(STAT_LISTS, 1);
+    STATS_ADD(STAT_LIST_BYTES, sizeof(LinkedList));
     ll->value = p_value;
     ll->previous_sibling = p_previous;
     return ll;
@@ -62,11 +68,23 @@ typedef struct {
 } Type;
 
 
+/*
+ * Where a skipped body is, until someone asks for it.
+*/
+typedef struct {
+    const BodyParser *parser;
+    uint32_t offset;
+    uint32_t end;
+    int line;
+} LazyScope;
+
+
 typedef struct {
     Node base;
     const Node *params;
     const Node *ret_type;
     const Node *scope;
+    const LazyScope *lazy;
 } Method;
 
 
@@ -82,13 +100,113 @@ typedef struct {
 } ParamList;
 
 
+typedef struct {
+    Node base;
+    Literal literal;
+} LiteralNode;
+
+
+typedef struct {
+    Node base;
+    TokenType operator;
+    const Node *operand;
+} Unary;
+
+
+typedef struct {
+    Node base;
+    TokenType operator;
+    const Node *left;
+    const Node *right;
+} Binary;
+
+
 NodeType nodeGetType(const Node *p_node) {
     return p_node->type;
 }
 
 
-Node *nodeIdentifierCreate(int p_uid) {
-    Identifier *id = ALLOC(Identifier);
+/*
+ * Nodes still to be counted. Operator chains are as deep as the text is
+ * long, either way they lean, so the count keeps a stack of its own.
+*/
+typedef struct {
+    const Node **nodes;
+    size_t count;
+    size_t capacity;
+} CountStack;
+
+
+static void _count_push(CountStack *p_stack, const Node *p_node) {
+    if (!p_node)
+        return;
+    if (p_stack->count == p_stack->capacity) {
+        size_t capacity = p_stack->capacity ? p_stack->capacity * 2 : 64;
+        const Node **grown = (const Node**)realloc(p_stack->nodes, capacity * sizeof(Node*));
+        if (!grown)
+            abort();
+        p_stack->nodes = grown;
+        p_stack->capacity = capacity;
+    }
+    p_stack->nodes[p_stack->count++] = p_node;
+}
+
+
+static void _count_list(CountStack *p_stack, const LinkedList *p_list) {
+    for (; p_list; p_list = p_list->previous_sibling)
+        _count_push(p_stack, (const Node*)p_list->value);
+}
+
+
+size_t nodeCount(const Node *p_node) {
+    CountStack stack = {NULL, 0, 0};
+    size_t count = 0;
+    _count_push(&stack, p_node);
+    while (stack.count) {
+        const Node *node = stack.nodes[--stack.count];
+        count++;
+        switch (node->type) {
+            case NODE_SPACE:
+                _count_list(&stack, ((const Space*)node)->last_child);
+                break;
+            case NODE_SCOPE:
+                _count_list(&stack, ((const Scope*)node)->last_child);
+                break;
+            case NODE_PARAMLIST:
+                _count_list(&stack, ((const ParamList*)node)->last_child);
+                break;
+            case NODE_LET:
+                _count_push(&stack, (const Node*)((const Let*)node)->identifier);
+                _count_push(&stack, ((const Let*)node)->value);
+                break;
+            case NODE_METHOD: {
+                const Method *method = (const Method*)node;
+                _count_push(&stack, method->params);
+                _count_push(&stack, method->ret_type);
+                _count_push(&stack, method->scope);
+                break;
+            }
+            case NODE_PARAM:
+                _count_push(&stack, ((const Param*)node)->type);
+                break;
+            case NODE_UNARY:
+                _count_push(&stack, ((const Unary*)node)->operand);
+                break;
+            case NODE_BINARY:
+                _count_push(&stack, ((const Binary*)node)->left);
+                _count_push(&stack, ((const Binary*)node)->right);
+                break;
+            default:
+                break;
+        }
+    }
+    free(stack.nodes);
+    return count;
+}
+
+
+Node *nodeIdentifierCreate(Arena *p_arena, uint32_t p_uid) {
+    Identifier *id = ALLOC_NODE(Identifier);
     *id = (Identifier){
         .base.type = NODE_IDENTIFIER,
         .uid = p_uid};
@@ -96,8 +214,8 @@ Node *nodeIdentifierCreate(int p_uid) {
 }
 
 
-Node *nodeSpaceCreate() {
-    Space *space = ALLOC(Space);
+Node *nodeSpaceCreate(Arena *p_arena) {
+    Space *space = ALLOC_NODE(Space);
     *space = (Space){
         .base.type = NODE_SPACE,
         .last_child = NULL
@@ -106,8 +224,8 @@ Node *nodeSpaceCreate() {
 }
 
 
-Node *nodeScopeCreate() {
-    Scope *scope = ALLOC(Scope);
+Node *nodeScopeCreate(Arena *p_arena) {
+    Scope *scope = ALLOC_NODE(Scope);
     *scope = (Scope){
         .base.type = NODE_SCOPE,
         .last_child = NULL
@@ -116,9 +234,9 @@ Node *nodeScopeCreate() {
 }
 
 
-Node *nodeLetCreate(const Node *p_identifier) {
+Node *nodeLetCreate(Arena *p_arena, const Node *p_identifier) {
     assert(p_identifier && p_identifier->type == NODE_IDENTIFIER);
-    Let *let = ALLOC(Let);
+    Let *let = ALLOC_NODE(Let);
     *let = (Let){
         .base.type = NODE_LET,
         .identifier = (Identifier*)p_identifier
@@ -127,21 +245,22 @@ Node *nodeLetCreate(const Node *p_identifier) {
 }
 
 
-Node *nodeMethodCreate() {
-    Method *method = ALLOC(Method);
+Node *nodeMethodCreate(Arena *p_arena) {
+    Method *method = ALLOC_NODE(Method);
     *method = (Method){
         .base.type = NODE_METHOD,
         .params = NULL,
         .ret_type = NULL,
-        .scope = NULL
+        .scope = NULL,
+        .lazy = NULL
     };
     return (Node*)method;
 }
 
 
-Node *nodeTypeCreate(TypeType p_type) {
+Node *nodeTypeCreate(Arena *p_arena, TypeType p_type) {
     // FIXME: implement this
-    Type *type = ALLOC(Type);
+    Type *type = ALLOC_NODE(Type);
     *type = (Type){
         .base.type = NODE_TYPE,
         .type = p_type,
@@ -151,8 +270,8 @@ Node *nodeTypeCreate(TypeType p_type) {
 }
 
 
-Node *nodeParamCreate(const Node *p_identifier) {
-    Param *param = ALLOC(Param);
+Node *nodeParamCreate(Arena *p_arena, const Node *p_identifier) {
+    Param *param = ALLOC_NODE(Param);
     *param = (Param){
         .base.type = NODE_PARAM,
         .type = NULL,
@@ -161,8 +280,8 @@ Node *nodeParamCreate(const Node *p_identifier) {
 }
 
 
-Node *nodeParamListCreate() {
-    ParamList *params = ALLOC(ParamList);
+Node *nodeParamListCreate(Arena *p_arena) {
+    ParamList *params = ALLOC_NODE(ParamList);
     *params = (ParamList){
         .base.type = NODE_PARAMLIST,
         .last_child = NULL,
@@ -171,17 +290,271 @@ Node *nodeParamListCreate() {
 }
 
 
-void nodeSpaceAddChild(Node *p_node, const Node *p_child) {
+Node *nodeLiteralCreate(Arena *p_arena, const Literal *p_literal) {
+    LiteralNode *lt = ALLOC_NODE(LiteralNode);
+    *lt = (LiteralNode){
+        .base.type = NODE_LITERAL,
+        .literal = *p_literal
+    };
+    // Copied and decoded up front so the string lives and dies with the tree, not with the text
+    if (lt->literal.type == LT_STRING) {
+        lt->literal.str.raw = arenaStrndup(p_arena, p_literal->str.raw, p_literal->str.raw_length);
+        char *decoded = (char*)arenaAllocAligned(p_arena, p_literal->str.raw_length + 1, 1);
+        literalStringDecode(p_literal->str.raw, p_literal->str.raw_length, decoded);
+        lt->literal.str.decoded = decoded;
+        STATS_ADD(STAT_LITERAL_BYTES, 2 * (p_literal->str.raw_length + 1));
+    }
+    return (Node*)lt;
+}
+
+
+Node *nodeUnaryCreate(Arena *p_arena, TokenType p_operator, const Node *p_operand) {
+    assert(p_operand);
+    Unary *unary = ALLOC_NODE(Unary);
+    *unary = (Unary){
+        .base.type = NODE_UNARY,
+        .operator = p_operator,
+        .operand = p_operand
+    };
+    return (Node*)unary;
+}
+
+
+Node *nodeBinaryCreate(Arena *p_arena, TokenType p_operator, const Node *p_left, const Node *p_right) {
+    assert(p_left && p_right);
+    Binary *binary = ALLOC_NODE(Binary);
+    *binary = (Binary){
+        .base.type = NODE_BINARY,
+        .operator = p_operator,
+        .left = p_left,
+        .right = p_right
+    };
+    return (Node*)binary;
+}
+
+
+void nodeSpaceAddChild(Arena *p_arena, Node *p_node, const Node *p_child) {
     assert(p_node && p_child && p_node->type == NODE_SPACE);
     Space *space = (Space*)p_node;
-    space->last_child = linkedListCreate(space->last_child, (void*)p_child);
+    space->last_child = linkedListCreate(p_arena, space->last_child, (void*)p_child);
 }
 
 
-void nodeScopeAddChild(Node *p_node, const Node *p_child) {
+/*
+ * Moves the children of p_other after those of p_node, p_other is left
+ * empty. Nothing is allocated, the lists are linked together.
+*/
+void nodeSpaceAppend(Node *p_node, Node *p_other) {
+    assert(p_node && p_other && p_node->type == NODE_SPACE && p_other->type == NODE_SPACE);
+    Space *space = (Space*)p_node;
+    Space *other = (Space*)p_other;
+    if (!other->last_child)
+        return;
+    LinkedList *first = other->last_child;
+    while (first->previous_sibling)
+        first = first->previous_sibling;
+    first->previous_sibling = space->last_child;
+    space->last_child = other->last_child;
+    other->last_child = NULL;
+}
+
+
+/*
+ * Replaces the p_removed children from p_index on, in source order, with
+ * p_children. The cells of the children that stay are kept as they are.
+*/
+void nodeSpaceReplace(Arena *p_arena, Node *p_node, size_t p_index, size_t p_removed,
+        Node *const *p_children, size_t p_count) {
+    assert(p_node && p_node->type == NODE_SPACE);
+    Space *space = (Space*)p_node;
+    size_t count = 0;
+    for (const LinkedList *child = space->last_child; child; child = child->previous_sibling)
+        count++;
+    assert(p_index + p_removed <= count);
+    // The list runs from the last child back, link ends on the last replaced one
+    LinkedList **link = &space->last_child;
+    for (size_t i = count; i > p_index + p_removed; i--)
+        link = &(*link)->previous_sibling;
+    LinkedList *before = *link;
+    for (size_t i = 0; i < p_removed; i++)
+        before = before->previous_sibling;
+    for (size_t i = 0; i < p_count; i++)
+        before = linkedListCreate(p_arena, before, (void*)p_children[i]);
+    *link = before;
+}
+
+
+void nodeScopeAddChild(Arena *p_arena, Node *p_node, const Node *p_child) {
     assert(p_node && p_child && p_node->type == NODE_SCOPE);
     Scope *scope = (Scope*)p_node;
-    scope->last_child = linkedListCreate(scope->last_child, (void*)p_child);
+    scope->last_child = linkedListCreate(p_arena, scope->last_child, (void*)p_child);
+}
+
+
+/*
+ * Where the flat nodes still to be filled come from: node i of the tree is
+ * made from sources[i]. A node reserves the block of its children when it
+ * is filled, and the pending stack fills the first child next, so every
+ * block lands right after the block of its parent and depth first walks
+ * stay on nearby memory. Interner ids are turned into symbols of the tree
+ * on first use so the tree does not depend on the interner.
+*/
+typedef struct {
+    FlatTree *tree;
+    const Node **sources;
+    FlatIndex *pending;
+    size_t pending_count;
+    size_t capacity;
+    uint32_t *symbols;
+    size_t symbol_capacity;
+} Flattener;
+
+
+static FlatIndex _flat_reserve(Flattener *p_flat, uint32_t p_count) {
+    FlatIndex first = flatTreeReserve(p_flat->tree, p_count);
+    size_t needed = first + p_count;
+    if (needed > p_flat->capacity) {
+        size_t capacity = p_flat->capacity * 2 > needed ? p_flat->capacity * 2 : needed;
+        const Node **sources = (const Node**)realloc(p_flat->sources, capacity * sizeof(Node*));
+        FlatIndex *pending = (FlatIndex*)realloc(p_flat->pending, capacity * sizeof(FlatIndex));
+        if (sources)
+            p_flat->sources = sources;
+        if (pending)
+            p_flat->pending = pending;
+        if (!sources || !pending)
+            abort();
+        p_flat->capacity = capacity;
+    }
+    // Pushed backwards so the first child comes out first
+    for (uint32_t i = p_count; i; i--)
+        p_flat->pending[p_flat->pending_count++] = first + i - 1;
+    return first;
+}
+
+
+static uint32_t _flat_symbol(Flattener *p_flat, uint32_t p_uid) {
+    // Bodies parsed on the way may intern names the table has not seen
+    if (p_uid >= p_flat->symbol_capacity) {
+        size_t capacity = p_flat->symbol_capacity * 2 > p_uid ? p_flat->symbol_capacity * 2 : p_uid + 1;
+        uint32_t *symbols = (uint32_t*)realloc(p_flat->symbols, capacity * sizeof(uint32_t));
+        if (!symbols)
+            abort();
+        memset(symbols + p_flat->symbol_capacity, 0xFF, (capacity - p_flat->symbol_capacity) * sizeof(uint32_t));
+        p_flat->symbols = symbols;
+        p_flat->symbol_capacity = capacity;
+    }
+    if (p_flat->symbols[p_uid] == FLAT_NONE)
+        p_flat->symbols[p_uid] = flatTreeAddSymbol(p_flat->tree, internerGetString(internerGlobal(), p_uid),
+            internerGetLength(internerGlobal(), p_uid));
+    return p_flat->symbols[p_uid];
+}
+
+
+static void _flat_children(Flattener *p_flat, FlatIndex p_index, const Node **p_children, uint32_t p_count) {
+    uint32_t count = 0;
+    for (uint32_t i = 0; i < p_count; i++)
+        count += p_children[i] != NULL;
+    FlatIndex first = _flat_reserve(p_flat, count);
+    FlatNode *node = flatTreeGetNode(p_flat->tree, p_index);
+    node->first_child = count ? first : FLAT_NONE;
+    node->child_count = count;
+    for (uint32_t i = 0; i < p_count; i++)
+        if (p_children[i])
+            p_flat->sources[first++] = p_children[i];
+}
+
+
+static void _flat_list(Flattener *p_flat, FlatIndex p_index, const LinkedList *p_last) {
+    uint32_t count = 0;
+    for (const LinkedList *child = p_last; child; child = child->previous_sibling)
+        count++;
+    FlatIndex first = _flat_reserve(p_flat, count);
+    FlatNode *node = flatTreeGetNode(p_flat->tree, p_index);
+    node->first_child = count ? first : FLAT_NONE;
+    node->child_count = count;
+    // The list runs backwards, so it is laid down from the end
+    for (const LinkedList *child = p_last; child; child = child->previous_sibling)
+        p_flat->sources[first + --count] = (const Node*)child->value;
+}
+
+
+FlatTree *nodeFlatten(const Node *p_root) {
+    uint64_t start = traceBegin();
+    size_t count = nodeCount(p_root);
+    Flattener flat = {
+        .tree = flatTreeInit(count),
+        .sources = (const Node**)malloc((count ? count : 1) * sizeof(Node*)),
+        .pending = (FlatIndex*)malloc((count ? count : 1) * sizeof(FlatIndex)),
+        .capacity = count ? count : 1,
+        .symbols = NULL,
+        .symbol_capacity = 0
+    };
+    if (!flat.tree || !flat.sources || !flat.pending)
+        abort();
+    if (p_root)
+        flat.sources[_flat_reserve(&flat, 1)] = p_root;
+
+    while (flat.pending_count) {
+        FlatIndex i = flat.pending[--flat.pending_count];
+        const Node *source = flat.sources[i];
+        FlatNode *node = flatTreeGetNode(flat.tree, i);
+        node->kind = (uint8_t)source->type;
+        node->first_child = FLAT_NONE;
+        switch (source->type) {
+            case NODE_IDENTIFIER:
+                node->data = _flat_symbol(&flat, ((const Identifier*)source)->uid);
+                break;
+            case NODE_TYPE:
+                node->data = ((const Type*)source)->type;
+                break;
+            case NODE_LITERAL:
+                node->data = flatTreeAddLiteral(flat.tree, &((const LiteralNode*)source)->literal);
+                break;
+            case NODE_SPACE:
+                _flat_list(&flat, i, ((const Space*)source)->last_child);
+                break;
+            case NODE_SCOPE:
+                _flat_list(&flat, i, ((const Scope*)source)->last_child);
+                break;
+            case NODE_PARAMLIST:
+                _flat_list(&flat, i, ((const ParamList*)source)->last_child);
+                break;
+            case NODE_LET: {
+                const Let *let = (const Let*)source;
+                _flat_children(&flat, i, (const Node*[]){(const Node*)let->identifier, let->value}, 2);
+                break;
+            }
+            case NODE_METHOD: {
+                const Method *method = (const Method*)source;
+                nodeMethodGetScope(source);
+                node->flags = (method->params ? FLAT_METHOD_PARAMS : 0)
+                    | (method->ret_type ? FLAT_METHOD_TYPE : 0)
+                    | (method->scope ? FLAT_METHOD_SCOPE : 0);
+                _flat_children(&flat, i, (const Node*[]){method->params, method->ret_type, method->scope}, 3);
+                break;
+            }
+            case NODE_PARAM:
+                _flat_children(&flat, i, (const Node*[]){((const Param*)source)->type}, 1);
+                break;
+            case NODE_UNARY: {
+                const Unary *unary = (const Unary*)source;
+                node->op = (uint8_t)unary->operator;
+                _flat_children(&flat, i, (const Node*[]){unary->operand}, 1);
+                break;
+            }
+            case NODE_BINARY: {
+                const Binary *binary = (const Binary*)source;
+                node->op = (uint8_t)binary->operator;
+                _flat_children(&flat, i, (const Node*[]){binary->left, binary->right}, 2);
+                break;
+            }
+        }
+    }
+    free(flat.sources);
+    free(flat.pending);
+    free(flat.symbols);
+    traceEnd("Flatten", NULL, start);
+    return flat.tree;
 }
 
 
@@ -215,16 +588,59 @@ void nodeMethodSetScope(Node *p_node, const Node *p_scope) {
 }
 
 
-Node *nodeTypeGetById(const Node *p_identifier) {
+void nodeMethodSetLazyScope(Arena *p_arena, Node *p_node, const BodyParser *p_parser, uint32_t p_offset, uint32_t p_end, int p_line) {
+    assert(p_node && p_node->type == NODE_METHOD && p_parser);
+    Method *method = (Method*)p_node;
+    assert(!method->scope && !method->lazy);
+    LazyScope *lazy = ALLOC(LazyScope);
+    *lazy = (LazyScope){
+        .parser = p_parser,
+        .offset = p_offset,
+        .end = p_end,
+        .line = p_line
+    };
+    method->lazy = lazy;
+}
+
+
+/*
+ * A skipped body is parsed the first time it is asked for, which fills the
+ * node in behind its const: the tree is not safe to share between threads
+ * while bodies are still pending.
+*/
+const Node *nodeMethodGetScope(const Node *p_node) {
+    assert(p_node && p_node->type == NODE_METHOD);
+    Method *method = (Method*)p_node;
+    if (!method->scope && method->lazy) {
+        const LazyScope *lazy = method->lazy;
+        method->lazy = NULL;
+        method->scope = lazy->parser->parse(lazy->parser->ctx, lazy->offset, lazy->line);
+    }
+    return method->scope;
+}
+
+
+bool nodeMethodGetBodyRange(const Node *p_node, uint32_t *p_offset, uint32_t *p_end) {
+    assert(p_node && p_node->type == NODE_METHOD);
+    const LazyScope *lazy = ((const Method*)p_node)->lazy;
+    if (!lazy)
+        return false;
+    *p_offset = lazy->offset;
+    *p_end = lazy->end;
+    return true;
+}
+
+
+Node *nodeTypeGetById(Arena *p_arena, const Node *p_identifier) {
     // FIXME: implement this
-    return nodeTypeCreate(TYPE_INTERFACE);
+    return nodeTypeCreate(p_arena, TYPE_INTERFACE);
 }
 
 
-void nodeParamListAddParam(Node *p_node, const Node *p_param) {
+void nodeParamListAddParam(Arena *p_arena, Node *p_node, const Node *p_param) {
     assert(p_node && p_param && p_node->type == NODE_PARAMLIST && p_param->type == NODE_PARAM);
     ParamList *params = (ParamList*)p_node;
-    params->last_child = linkedListCreate(params->last_child, (void*)p_param);
+    params->last_child = linkedListCreate(p_arena, params->last_child, (void*)p_param);
 }
 
 
@@ -235,96 +651,12 @@ void nodeParamSetType(Node *p_node, const Node* p_type) {
 }
 
 
-
-
-/* ************************************************
- * ************************************************
- * ************************************************
- * ************************************************
- */
-
-
-static inline void _indent(int p_indent) { for (;p_indent; p_indent--) printf("  "); }
-
-void nodeExpose(const Node *p_node) {
-    if (!p_node){
-        return;
-    }
-    static int indent = 0;
-    switch (p_node->type) {
-        case NODE_SPACE: {
-            putchar('\n');
-            Space *space = (Space*)p_node;
-            _indent(indent);
-            puts("space {");
-            indent++;
-            for (LinkedList *child = space->last_child; child; child = child->previous_sibling)
-                nodeExpose((Node*)child->value);
-            indent--;
-            _indent(indent);
-            puts("} #space");
-            putchar('\n');
-            return;
-        }
-        case NODE_SCOPE: {
-            Scope *scope = (Scope*)p_node;
-            putchar('\n');
-            _indent(indent);
-            puts("scope {");
-            indent++;
-            for (LinkedList *child = scope->last_child; child; child = child->previous_sibling)
-                nodeExpose((Node*)child->value);
-            indent--;
-            _indent(indent);
-            puts("} #scope");
-            putchar('\n');
-            return;
-        }
-        case NODE_LET: {
-            Let *let = (Let*)p_node;
-            if (!let->value)
-                putchar('\n');
-            _indent(indent);
-            uint64_t id = hashBase53(let->identifier->uid);
-            if (!let->value) {
-                printf("let %.6s\n", (char*)&id);
-                return;
-            }
-
-            printf("let %.6s {\n", (char*)&id);
-
-            indent++;
-            nodeExpose(let->value);
-            indent--;
-            _indent(indent);
-            puts("} #let");
-            putchar('\n');
-            return;
-        }
-        case NODE_METHOD: {
-            Method *method = (Method*)p_node;
-            putchar('\n');
-            _indent(indent);
-            if (method->ret_type)
-                printf("method %d {", ((Type*)method->ret_type)->type);
-            else
-                puts("method {");
-            indent++;
-            nodeExpose(method->scope);
-            indent--;
-            _indent(indent);
-            puts("} #method");
-            putchar('\n');
-            return;
-        }
-        case NODE_TYPE: {
-            Type *type = (Type*)p_node;
-            _indent(indent);
-            printf("type: %d\n", type->type);
-            return;
-        }
-        default:
-            assert(0);
-    }
+/*
+ * Counting, flattening and dumping all keep stacks of their own, a tree
+ * dumps whatever the depth of its operator chains (test/deep_chains.sh).
+*/
+void nodeDump(const Node *p_root, Sink *p_sink, DumpFormat p_format) {
+    FlatTree *tree = nodeFlatten(p_root);
+    flatTreeDump(tree, p_sink, p_format);
+    flatTreeTerminate(tree);
 }
-
@@ -1,6 +1,14 @@
 #ifndef SYNTAX_TREE_H
 #define SYNTAX_TREE_H
 
+#include "../frontend/tokenizer.h"
+#include "../extra/arena.h"
+#include "flat_tree.h"
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
 typedef enum {
     NODE_IDENTIFIER,
     NODE_TYPE,
@@ -10,6 +18,9 @@ typedef enum {
     NODE_METHOD,
     NODE_PARAM,
     NODE_PARAMLIST,
+    NODE_LITERAL,
+    NODE_UNARY,
+    NODE_BINARY,
 } NodeType;
 
 typedef enum {
@@ -20,29 +31,49 @@ typedef enum {
 
 typedef struct Node Node;
 
+/*
+ * Builds a method body that was skipped, from the "{" at p_offset on line
+ * p_line of the source. Returns NULL when the body turns out invalid.
+*/
+typedef struct {
+    Node *(*parse)(void *p_ctx, uint32_t p_offset, int p_line);
+    void *ctx;
+} BodyParser;
+
 
-void nodeExpose(const Node *p_node);
+void nodeDump(const Node *p_root, Sink *p_sink, DumpFormat p_format);
+size_t nodeCount(const Node *p_node);
+FlatTree *nodeFlatten(const Node *p_root);
 
 
-Node *nodeIdentifierCreate(int p_value);
-Node *nodeSpaceCreate();
-Node *nodeScopeCreate();
-Node *nodeLetCreate(const Node *p_identifier);
-Node *nodeMethodCreate();
-Node *nodeTypeCreate(TypeType p_type);
-Node *nodeParamCreate(const Node *p_identifier);
-Node *nodeParamListCreate();
+Node *nodeIdentifierCreate(Arena *p_arena, uint32_t p_uid);
+Node *nodeSpaceCreate(Arena *p_arena);
+Node *nodeScopeCreate(Arena *p_arena);
+Node *nodeLetCreate(Arena *p_arena, const Node *p_identifier);
+Node *nodeMethodCreate(Arena *p_arena);
+Node *nodeTypeCreate(Arena *p_arena, TypeType p_type);
+Node *nodeParamCreate(Arena *p_arena, const Node *p_identifier);
+Node *nodeParamListCreate(Arena *p_arena);
+Node *nodeLiteralCreate(Arena *p_arena, const Literal *p_literal);
+Node *nodeUnaryCreate(Arena *p_arena, TokenType p_operator, const Node *p_operand);
+Node *nodeBinaryCreate(Arena *p_arena, TokenType p_operator, const Node *p_left, const Node *p_right);
 
 
 
-void nodeSpaceAddChild(Node *p_node, const Node *p_child);
-void nodeScopeAddChild(Node *p_node, const Node *p_child);
+void nodeSpaceAddChild(Arena *p_arena, Node *p_node, const Node *p_child);
+void nodeSpaceAppend(Node *p_node, Node *p_other);
+void nodeSpaceReplace(Arena *p_arena, Node *p_node, size_t p_index, size_t p_removed,
+        Node *const *p_children, size_t p_count);
+void nodeScopeAddChild(Arena *p_arena, Node *p_node, const Node *p_child);
 void nodeLetSetValue(Node *p_node, const Node *p_value);
 void nodeMethodSetParameters(Node *p_node, const Node *p_param);
 void nodeMethodSetType(Node *p_node, const Node *p_type);
 void nodeMethodSetScope(Node *p_node, const Node *p_scope);
-Node *nodeTypeGetById(const Node *p_identifier);
-void nodeParamListAddParam(Node *p_node, const Node *p_param);
+void nodeMethodSetLazyScope(Arena *p_arena, Node *p_node, const BodyParser *p_parser, uint32_t p_offset, uint32_t p_end, int p_line);
+const Node *nodeMethodGetScope(const Node *p_node);
+bool nodeMethodGetBodyRange(const Node *p_node, uint32_t *p_offset, uint32_t *p_end);
+Node *nodeTypeGetById(Arena *p_arena, const Node *p_identifier);
+void nodeParamListAddParam(Arena *p_arena, Node *p_node, const Node *p_param);
 void nodeParamSetType(Node *p_node, const Node* p_type);
 
 
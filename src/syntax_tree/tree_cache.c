@@ -0,0 +1,297 @@
+#define _XOPEN_SOURCE 700
+#include "tree_cache.h"
+#include "../extra/hash.h"
+#include "../extra/trace.h"
+
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/file.h>
+#include <sys/stat.h>
+
+// "/" then 16 hex digits and the extension
+#define ENTRY_NAME_SIZE 32
+#define ENTRY_EXTENSION ".rast"
+// Running total of the bytes in the directory, also what builds lock around it
+#define LEDGER_NAME "/ledger"
+// A trim goes down to this fraction of the limit, so the next store does not trim again
+#define TRIM_TARGET(LIMIT) ((LIMIT) / 4 * 3)
+// A temporary file this old belongs to a build that died while saving
+#define STALE_TEMP_SECONDS 3600
+
+
+/*
+ * Entries are named after the content key mixed with a salt made of
+ * whatever else decides the tree: the version of the frontend, of the file
+ * layout, and the options given. Files of several checkouts and several
+ * builds land on the same entries as long as all of that matches.
+ * The ledger holds the total size of the entries, written under an flock
+ * so builds sharing the directory keep it right. Past the limit the least
+ * recently used entries go, a hit counts as a use.
+*/
+struct TreeCache {
+    char *dir;
+    size_t dir_length;
+    uint64_t salt;
+    uint64_t limit;
+    int ledger;
+    // flock does not keep apart threads sharing the descriptor
+    pthread_mutex_t mutex;
+};
+
+
+typedef struct {
+    char *name;
+    time_t used;
+    uint64_t size;
+} Entry;
+
+
+/*
+ * mkdir -p, the directory may well be shared by several builds at once.
+*/
+static int _make_dirs(char *p_path) {
+    for (char *c = p_path + 1; *c; c++) {
+        if (*c != '/')
+            continue;
+        *c = '\0';
+        int status = mkdir(p_path, 0777);
+        *c = '/';
+        if (status && errno != EEXIST)
+            return -1;
+    }
+    return mkdir(p_path, 0777) && errno != EEXIST ? -1 : 0;
+}
+
+
+static char *_entry_path(const TreeCache *p_cache, uint64_t p_key) {
+    char *path = (char*)malloc(p_cache->dir_length + ENTRY_NAME_SIZE);
+    if (!path)
+        abort();
+    memcpy(path, p_cache->dir, p_cache->dir_length);
+    snprintf(path + p_cache->dir_length, ENTRY_NAME_SIZE, "/%016llx" ENTRY_EXTENSION, (unsigned long long)p_key);
+    return path;
+}
+
+
+static uint64_t _salted(const TreeCache *p_cache, uint64_t p_key) {
+    uint64_t words[2] = {p_key, p_cache->salt};
+    return hashWords64((const char*)words, sizeof(words));
+}
+
+
+static bool _ends_with(const char *p_name, const char *p_end) {
+    size_t length = strlen(p_name), end = strlen(p_end);
+    return length >= end && !memcmp(p_name + length - end, p_end, end);
+}
+
+
+static int _compare_entries(const void *p_a, const void *p_b) {
+    time_t a = ((const Entry*)p_a)->used, b = ((const Entry*)p_b)->used;
+    return (a > b) - (a < b);
+}
+
+
+static uint64_t _read_ledger(const TreeCache *p_cache) {
+    uint64_t total = 0;
+    if (pread(p_cache->ledger, &total, sizeof(total), 0) != sizeof(total))
+        return 0;
+    return total;
+}
+
+
+static void _write_ledger(const TreeCache *p_cache, uint64_t p_total) {
+    if (pwrite(p_cache->ledger, &p_total, sizeof(p_total), 0) != sizeof(p_total))
+        return;
+}
+
+
+static void _lock(TreeCache *p_cache) {
+    pthread_mutex_lock(&p_cache->mutex);
+    while (flock(p_cache->ledger, LOCK_EX) && errno == EINTR);
+}
+
+
+static void _unlock(TreeCache *p_cache) {
+    flock(p_cache->ledger, LOCK_UN);
+    pthread_mutex_unlock(&p_cache->mutex);
+}
+
+
+/*
+ * Counts every entry again, since the ledger drifts when entries are
+ * overwritten or removed by hand, and evicts the oldest when over the limit.
+ * Called with the ledger locked.
+*/
+static int _trim(TreeCache *p_cache) {
+    DIR *dir = opendir(p_cache->dir);
+    if (!dir)
+        return -1;
+    Entry *entries = NULL;
+    size_t count = 0, capacity = 0;
+    uint64_t total = 0;
+    time_t now = time(NULL);
+    struct dirent *entry;
+    while ((entry = readdir(dir))) {
+        struct stat st;
+        if (fstatat(dirfd(dir), entry->d_name, &st, AT_SYMLINK_NOFOLLOW) || !S_ISREG(st.st_mode))
+            continue;
+        if (strstr(entry->d_name, ".tmp.")) {
+            if (st.st_mtime < now - STALE_TEMP_SECONDS)
+                unlinkat(dirfd(dir), entry->d_name, 0);
+            continue;
+        }
+        if (!_ends_with(entry->d_name, ENTRY_EXTENSION))
+            continue;
+        if (count == capacity) {
+            capacity = capacity ? capacity * 2 : 256;
+            Entry *grown = (Entry*)realloc(entries, capacity * sizeof(Entry));
+            if (!grown)
+                abort();
+            entries = grown;
+        }
+        if (!(entries[count].name = strdup(entry->d_name)))
+            abort();
+        entries[count].used = st.st_mtime;
+        entries[count++].size = st.st_size;
+        total += st.st_size;
+    }
+
+    if (p_cache->limit && total > p_cache->limit) {
+        qsort(entries, count, sizeof(Entry), _compare_entries);
+        for (size_t i = 0; i < count && total > TRIM_TARGET(p_cache->limit); i++) {
+            if (!unlinkat(dirfd(dir), entries[i].name, 0) || errno == ENOENT)
+                total -= entries[i].size;
+        }
+    }
+    closedir(dir);
+    for (size_t i = 0; i < count; i++)
+        free(entries[i].name);
+    free(entries);
+    _write_ledger(p_cache, total);
+    return 0;
+}
+
+
+/*
+ * p_flags stands for the options that change what a text parses to, NULL
+ * when there are none.
+*/
+TreeCache *treeCacheInit(const char *p_dir, const char *p_flags) {
+    TreeCache *cache = (TreeCache*)malloc(sizeof(TreeCache));
+    if (!cache)
+        return NULL;
+    char *dir = strdup(p_dir);
+    if (!dir) {
+        free(cache);
+        return NULL;
+    }
+    // Made absolute, whoever uses the cache may change directory
+    cache->dir = _make_dirs(dir) ? NULL : realpath(dir, NULL);
+    free(dir);
+    if (!cache->dir) {
+        free(cache);
+        return NULL;
+    }
+    cache->dir_length = strlen(cache->dir);
+    char *ledger = (char*)malloc(cache->dir_length + sizeof(LEDGER_NAME));
+    if (!ledger)
+        abort();
+    memcpy(ledger, cache->dir, cache->dir_length);
+    memcpy(ledger + cache->dir_length, LEDGER_NAME, sizeof(LEDGER_NAME));
+    cache->ledger = open(ledger, O_RDWR | O_CREAT, 0644);
+    free(ledger);
+    if (cache->ledger < 0) {
+        free(cache->dir);
+        free(cache);
+        return NULL;
+    }
+
+    char salt[256];
+    int length = snprintf(salt, sizeof(salt), "rulma frontend %d flat tree %d %s",
+        TREE_CACHE_FRONTEND_VERSION, FLAT_TREE_VERSION, p_flags ? p_flags : "");
+    cache->salt = hashWords64(salt, length < (int)sizeof(salt) ? (size_t)length : sizeof(salt) - 1);
+    cache->limit = TREE_CACHE_DEFAULT_LIMIT;
+    pthread_mutex_init(&cache->mutex, NULL);
+    return cache;
+}
+
+
+/*
+ * At most p_bytes of trees are kept, 0 for no limit.
+*/
+void treeCacheSetLimit(TreeCache *p_cache, uint64_t p_bytes) {
+    p_cache->limit = p_bytes;
+}
+
+
+uint64_t treeCacheKey(const char *p_source, size_t p_size) {
+    return hashWords64(p_source, p_size);
+}
+
+
+/*
+ * The tree saved for a source of p_size bytes hashing to p_key, NULL on a
+ * miss. An entry that is stale, of another source or damaged is a miss too.
+*/
+FlatTree *treeCacheLoad(TreeCache *p_cache, uint64_t p_key, size_t p_size) {
+    uint64_t start = traceBegin();
+    uint64_t key = _salted(p_cache, p_key);
+    char *path = _entry_path(p_cache, key);
+    // The key and size are checked again against the file, a stale one is a miss
+    FlatTree *tree = flatTreeMap(path, key, p_size);
+    // Used just now as far as eviction goes
+    if (tree)
+        utimensat(AT_FDCWD, path, NULL, 0);
+    traceEnd(tree ? "Cache hit" : "Cache miss", path, start);
+    free(path);
+    return tree;
+}
+
+
+int treeCacheStore(TreeCache *p_cache, uint64_t p_key, size_t p_size, const FlatTree *p_tree) {
+    uint64_t start = traceBegin();
+    uint64_t key = _salted(p_cache, p_key);
+    char *path = _entry_path(p_cache, key);
+    int status = flatTreeSave(p_tree, path, key, p_size);
+    traceEnd("Cache store", path, start);
+    free(path);
+    if (status)
+        return status;
+    _lock(p_cache);
+    uint64_t total = _read_ledger(p_cache) + flatTreeGetBytes(p_tree);
+    _write_ledger(p_cache, total);
+    if (p_cache->limit && total > p_cache->limit) {
+        start = traceBegin();
+        status = _trim(p_cache);
+        traceEnd("Cache trim", NULL, start);
+    }
+    _unlock(p_cache);
+    return status;
+}
+
+
+/*
+ * Recounts the directory and evicts down to the limit if over it.
+*/
+int treeCacheTrim(TreeCache *p_cache) {
+    _lock(p_cache);
+    int status = _trim(p_cache);
+    _unlock(p_cache);
+    return status;
+}
+
+
+void treeCacheTerminate(TreeCache *p_cache) {
+    close(p_cache->ledger);
+    pthread_mutex_destroy(&p_cache->mutex);
+    free(p_cache->dir);
+    free(p_cache);
+}
@@ -0,0 +1,31 @@
+#ifndef TREE_CACHE_H
+#define TREE_CACHE_H
+
+#include "flat_tree.h"
+
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * Flat trees saved in a directory, one file per distinct source text named
+ * after a hash of its content. A hit is mapped and used in place, so an
+ * unchanged file never goes through the tokenizer nor the parser again.
+ * Nothing ties an entry to a path: checkouts and builds running at once
+ * share the directory, and a cache is safe to share between threads.
+*/
+typedef struct TreeCache TreeCache;
+
+// Bumped whenever the same text would parse to another tree
+#define TREE_CACHE_FRONTEND_VERSION 1
+#define TREE_CACHE_DEFAULT_LIMIT ((uint64_t)1 << 30)
+
+
+TreeCache *treeCacheInit(const char *p_dir, const char *p_flags);
+void treeCacheSetLimit(TreeCache *p_cache, uint64_t p_bytes);
+uint64_t treeCacheKey(const char *p_source, size_t p_size);
+FlatTree *treeCacheLoad(TreeCache *p_cache, uint64_t p_key, size_t p_size);
+int treeCacheStore(TreeCache *p_cache, uint64_t p_key, size_t p_size, const FlatTree *p_tree);
+int treeCacheTrim(TreeCache *p_cache);
+void treeCacheTerminate(TreeCache *p_cache);
+
+#endif // TREE_CACHE_H
@@ -0,0 +1,41 @@
+#!/bin/sh
+# Operator chains far deeper than the C stack allows recursion for, built on
+# the fly since they run to megabytes. Each has to parse, dump and go through
+# the cache without crashing.
+#   test/deep_chains.sh <path to rulma>
+RULMA=${1:?usage: $0 <path to rulma>}
+DEPTH=${DEPTH:-300000}
+DIR=$(mktemp -d) || exit 1
+trap 'rm -rf "$DIR"' EXIT
+
+chain() {
+    awk -v n="$DEPTH" -v head="$2" -v link="$3" -v tail="$4" 'BEGIN {
+        printf "let x = %s", head
+        for (i = 0; i < n; i++) printf "%s", link
+        printf "%s\n", tail
+    }' > "$DIR/$1.rl"
+}
+
+chain power a ' ** a' ''
+chain assign a ' = a' ''
+chain unary '' '-' 'a'
+chain group '' '(' 'a'
+# Closing the groups, in a second pass to keep awk simple
+awk -v n="$DEPTH" 'BEGIN { for (i = 0; i < n; i++) printf ")"; printf "\n" }' > "$DIR/close"
+tr -d '\n' < "$DIR/group.rl" > "$DIR/open" && cat "$DIR/open" "$DIR/close" > "$DIR/group.rl"
+
+status=0
+for file in "$DIR"/*.rl; do
+    for args in "" "--compact" "--cache $DIR/cache" "--cache $DIR/cache"; do
+        if ! "$RULMA" $args "$file" > /dev/null; then
+            echo "FAIL: $RULMA $args $(basename "$file")"
+            status=1
+        fi
+    done
+done
+if ! "$RULMA" --compact "$DIR" > /dev/null 2>&1; then
+    echo "FAIL: $RULMA --compact <directory of chains>"
+    status=1
+fi
+[ $status = 0 ] && echo "deep chains: ok"
+exit $status
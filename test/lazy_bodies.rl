@@ -0,0 +1,22 @@
+let outer(a: int, b: int) int {
+    let inner(c: int) int {
+        let deepest() {
+            let z = c * (a + b)
+        }
+        let y = c ** 2 ** 3
+        -y
+    }
+    let x = a = b = -(a + b) * 3
+    let empty() {}
+    inner(x)
+}
+
+let s = "text with { and } inside"
+
+let typed(v: int) int {
+    let w = v + 1
+}
+
+let noparams() {
+    let n = 0x10 + 2.5
+}
@@ -0,0 +1,52 @@
+#!/bin/sh
+# Method bodies skipped while parsing and parsed as the tree is dumped have
+# to come out as if they had been parsed in place, on one thread or several,
+# alone or through the driver. A body that fails has to fail its file the
+# same way, and leave nothing in the cache.
+#   test/lazy_bodies.sh <path to rulma>
+RULMA=${1:?usage: $0 <path to rulma>}
+TEST=$(dirname "$0")
+DIR=$(mktemp -d) || exit 1
+trap 'rm -rf "$DIR"' EXIT
+printf 'let f() {\n    let x = 1\n}\n\nlet g() int { let y = 2; }\n' > "$DIR/bad_body.rl"
+
+status=0
+# Output and exit status of an eager run then of a lazy one, args first
+same() {
+    "$RULMA" "$@" > "$DIR/eager" 2>&1
+    echo "exit $?" >> "$DIR/eager"
+    "$RULMA" --lazy-bodies "$@" > "$DIR/lazy" 2>&1
+    echo "exit $?" >> "$DIR/lazy"
+    if ! cmp -s "$DIR/eager" "$DIR/lazy"; then
+        echo "FAIL: $RULMA --lazy-bodies $*"
+        status=1
+    fi
+}
+
+for file in "$TEST/lazy_bodies.rl" "$TEST/test.rl" "$DIR/bad_body.rl"; do
+    for args in "" "--compact" "--threads 4" "--compact --threads 4"; do
+        same $args "$file"
+    done
+done
+# Through the driver, the totals line aside since it holds timings
+for args in "--compact" "--compact --threads 2"; do
+    "$RULMA" $args "$TEST/lazy_bodies.rl" "$TEST/test.rl" "$DIR/bad_body.rl" 2> /dev/null > "$DIR/eager"
+    echo "exit $?" >> "$DIR/eager"
+    "$RULMA" --lazy-bodies $args "$TEST/lazy_bodies.rl" "$TEST/test.rl" "$DIR/bad_body.rl" 2> /dev/null > "$DIR/lazy"
+    echo "exit $?" >> "$DIR/lazy"
+    if ! cmp -s "$DIR/eager" "$DIR/lazy"; then
+        echo "FAIL: $RULMA --lazy-bodies $args <three files>"
+        status=1
+    fi
+done
+# A failed body is not cached, a later eager run still fails
+for args in "" "--compact"; do
+    "$RULMA" --lazy-bodies --cache "$DIR/cache" $args "$DIR/bad_body.rl" > /dev/null 2>&1
+    "$RULMA" --lazy-bodies --cache "$DIR/cache" $args "$TEST/test.rl" "$DIR/bad_body.rl" > /dev/null 2>&1
+    if "$RULMA" --cache "$DIR/cache" $args "$DIR/bad_body.rl" > /dev/null 2>&1; then
+        echo "FAIL: $RULMA --cache $args bad_body.rl after --lazy-bodies"
+        status=1
+    fi
+done
+[ $status = 0 ] && echo "lazy bodies: ok"
+exit $status
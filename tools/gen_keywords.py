@@ -0,0 +1,96 @@
+#!/usr/bin/env python3
+"""
+Generates src/frontend/keywords.h, a collision free hash table of the
+language keywords. The keyword list is taken from the TokenType enum in
+tokenizer.h and the matching token_names entries in tokenizer.c.
+"""
+
+import re
+import sys
+from pathlib import Path
+
+ROOT = Path(__file__).resolve().parent.parent
+HEADER = ROOT / "src/frontend/tokenizer.h"
+SOURCE = ROOT / "src/frontend/tokenizer.c"
+OUTPUT = ROOT / "src/frontend/keywords.h"
+
+KEYWORD_SECTIONS = {"Logical", "Control flow", "Keywords", "Constants"}
+WORD = re.compile(r"^[A-Za-z_][A-Za-z0-9_]*$")
+TABLE_BITS = 7
+
+
+def token_types():
+    body = HEADER.read_text().split("typedef enum {", 1)[1].split("} TokenType;", 1)[0]
+    section = None
+    for line in body.splitlines():
+        line = line.strip()
+        if line.startswith("//"):
+            section = line[2:].strip()
+        elif line:
+            yield line.rstrip(","), section
+
+
+def token_names():
+    body = SOURCE.read_text().split("token_names[] = {", 1)[1].split("};", 1)[0]
+    return re.findall(r'^\s*"((?:[^"\\]|\\.)*)"', body, re.MULTILINE)
+
+
+def keywords():
+    types = list(token_types())
+    names = token_names()
+    if len(types) != len(names):
+        sys.exit("gen_keywords: TokenType and token_names are out of sync")
+    return [(name, tk) for (tk, section), name in zip(types, names)
+            if section in KEYWORD_SECTIONS and WORD.match(name)]
+
+
+def slot(name, a, b):
+    first, last = ord(name[0]), ord(name[-1])
+    return ((first * a) ^ (last * b) ^ len(name)) & ((1 << TABLE_BITS) - 1)
+
+
+def find_seeds(words):
+    for a in range(1, 256):
+        for b in range(1, 256):
+            if len({slot(w, a, b) for w, _ in words}) == len(words):
+                return a, b
+    sys.exit("gen_keywords: no perfect hash found, increase TABLE_BITS")
+
+
+def main():
+    words = keywords()
+    a, b = find_seeds(words)
+    table = [None] * (1 << TABLE_BITS)
+    for word, tk in words:
+        table[slot(word, a, b)] = (word, tk)
+
+    lengths = [len(w) for w, _ in words]
+    out = [
+        "/* This file is generated by tools/gen_keywords.py from the TokenType enum and",
+        " * token_names. Do not edit! */",
+        "",
+        "#ifndef KEYWORDS_H",
+        "#define KEYWORDS_H",
+        "",
+        "#include <stdint.h>",
+        "",
+        f"#define KEYWORD_MIN_LENGTH {min(lengths)}",
+        f"#define KEYWORD_MAX_LENGTH {max(lengths)}",
+        f"#define KEYWORD_HASH(S, L) (((uint8_t)(S)[0] * {a}u ^ (uint8_t)(S)[(L) - 1] * {b}u ^ (uint32_t)(L)) & {(1 << TABLE_BITS) - 1}u)",
+        "",
+        "static const struct {",
+        "\tconst char *name;",
+        "\tuint8_t length;",
+        "\tuint8_t type;",
+        f"}} keyword_table[{1 << TABLE_BITS}] = {{",
+    ]
+    for i, entry in enumerate(table):
+        if entry:
+            word, tk = entry
+            out.append(f'\t[{i}] = {{"{word}", {len(word)}, {tk}}},')
+    out += ["};", "", "#endif // KEYWORDS_H", ""]
+    OUTPUT.write_text("\n".join(out))
+
+
+if __name__ == "__main__":
+    main()